@@ -0,0 +1,370 @@
+#include "Report.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include "libs.h"
+
+// JSON reading
+#if 1
+// Just enough JSON for the files writeReport produces: objects, arrays,
+// strings, numbers, true/false/null.
+struct JsonValue
+{
+	enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT } type = NUL;
+
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::map<std::string, JsonValue> object;
+
+	const JsonValue* find(const std::string& key) const {
+		auto found = object.find(key);
+		return found == object.end() ? nullptr : &found->second;
+	}
+
+	double getNumber(const std::string& key, double fallback) const {
+		const JsonValue* value = find(key);
+		return value && value->type == NUMBER ? value->number : fallback;
+	}
+
+	std::string getString(const std::string& key) const {
+		const JsonValue* value = find(key);
+		return value && value->type == STRING ? value->string : std::string();
+	}
+};
+
+class JsonParser
+{
+public:
+	JsonParser(const std::string& text) : text(text) {}
+
+	JsonValue parse() {
+		JsonValue value = parseValue();
+		skipWhitespace();
+		if (pos != text.size()) fail("trailing characters");
+		return value;
+	}
+
+private:
+	const std::string& text;
+	size_t pos = 0;
+
+	void fail(const std::string& what) {
+		ERROR("Invalid JSON at offset " + std::to_string(pos) + ": " + what);
+	}
+
+	void skipWhitespace() {
+		while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+	}
+
+	bool consume(char c) {
+		skipWhitespace();
+		if (pos < text.size() && text[pos] == c) {
+			pos++;
+			return true;
+		}
+		return false;
+	}
+
+	void expect(char c) {
+		if (!consume(c)) fail(std::string("expected '") + c + "'");
+	}
+
+	bool consumeWord(const char* word) {
+		size_t length = strlen(word);
+		if (text.compare(pos, length, word) == 0) {
+			pos += length;
+			return true;
+		}
+		return false;
+	}
+
+	JsonValue parseValue() {
+		skipWhitespace();
+		if (pos >= text.size()) fail("unexpected end");
+
+		JsonValue value;
+		char c = text[pos];
+
+		if (c == '{') {
+			value.type = JsonValue::OBJECT;
+			pos++;
+			if (consume('}')) return value;
+			do {
+				skipWhitespace();
+				std::string key = parseString();
+				expect(':');
+				value.object[key] = parseValue();
+			} while (consume(','));
+			expect('}');
+		}
+		else if (c == '[') {
+			value.type = JsonValue::ARRAY;
+			pos++;
+			if (consume(']')) return value;
+			do {
+				value.array.push_back(parseValue());
+			} while (consume(','));
+			expect(']');
+		}
+		else if (c == '"') {
+			value.type = JsonValue::STRING;
+			value.string = parseString();
+		}
+		else if (consumeWord("true")) {
+			value.type = JsonValue::BOOLEAN;
+			value.number = 1.0;
+		}
+		else if (consumeWord("false")) {
+			value.type = JsonValue::BOOLEAN;
+		}
+		else if (consumeWord("null")) {
+			value.type = JsonValue::NUL;
+		}
+		else {
+			const char* start = text.c_str() + pos;
+			char* end;
+			value.type = JsonValue::NUMBER;
+			value.number = strtod(start, &end);
+			if (end == start) fail("unexpected character");
+			pos += end - start;
+		}
+
+		return value;
+	}
+
+	std::string parseString() {
+		if (pos >= text.size() || text[pos] != '"') fail("expected string");
+		pos++;
+
+		std::string result;
+		while (pos < text.size() && text[pos] != '"') {
+			char c = text[pos++];
+			if (c == '\\' && pos < text.size()) {
+				char escaped = text[pos++];
+				switch (escaped) {
+				case 'n': c = '\n'; break;
+				case 't': c = '\t'; break;
+				case 'r': c = '\r'; break;
+				case 'b': c = '\b'; break;
+				case 'f': c = '\f'; break;
+				case 'u': appendUtf8(result, parseCodePoint()); continue;
+				default: c = escaped; break;
+				}
+			}
+			result += c;
+		}
+
+		if (pos >= text.size()) fail("unterminated string");
+		pos++;
+		return result;
+	}
+
+	uint32_t parseHex4() {
+		if (pos + 4 > text.size()) fail("truncated \\u escape");
+
+		uint32_t value = 0;
+		for (int i = 0; i < 4; i++) {
+			char c = text[pos++];
+			value <<= 4;
+			if (c >= '0' && c <= '9') value |= c - '0';
+			else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+			else fail("invalid \\u escape");
+		}
+		return value;
+	}
+
+	// After the "\u"; joins surrogate pairs.
+	uint32_t parseCodePoint() {
+		uint32_t code = parseHex4();
+		if (code >= 0xD800 && code <= 0xDBFF && text.compare(pos, 2, "\\u") == 0) {
+			pos += 2;
+			uint32_t low = parseHex4();
+			if (low < 0xDC00 || low > 0xDFFF) fail("invalid surrogate pair");
+			code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+		}
+		return code;
+	}
+
+	static void appendUtf8(std::string& out, uint32_t code) {
+		if (code < 0x80) {
+			out += static_cast<char>(code);
+		}
+		else if (code < 0x800) {
+			out += static_cast<char>(0xC0 | (code >> 6));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else if (code < 0x10000) {
+			out += static_cast<char>(0xE0 | (code >> 12));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else {
+			out += static_cast<char>(0xF0 | (code >> 18));
+			out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+	}
+};
+#endif
+
+std::string escapeJson(const std::string& str) {
+	static const char hex[] = "0123456789abcdef";
+
+	std::string result;
+	for (char c : str) {
+		unsigned char u = static_cast<unsigned char>(c);
+		if (c == '"' || c == '\\') result += '\\';
+		if (c == '\n') { result += "\\n"; continue; }
+		// JSON doesn't allow raw control characters in strings.
+		if (u < 0x20) {
+			result += "\\u00";
+			result += hex[u >> 4];
+			result += hex[u & 0xF];
+			continue;
+		}
+		result += c;
+	}
+	return result;
+}
+
+void writeReport(std::ostream& out, const Report& report) {
+	out << std::fixed << std::setprecision(4);
+	out << "{\n";
+	out << "\t\"device\": \"" << escapeJson(report.device) << "\",\n";
+	out << "\t\"mathBackend\": \"" << escapeJson(report.mathBackend) << "\",\n";
+	out << "\t\"width\": " << report.width << ",\n";
+	out << "\t\"height\": " << report.height << ",\n";
+	out << "\t\"frames\": " << report.frames << ",\n";
+	out << "\t\"scenes\": [";
+
+	for (size_t i = 0; i < report.scenes.size(); i++) {
+		const SceneResult& scene = report.scenes[i];
+
+		out << (i ? "," : "") << "\n\t\t{\n";
+		out << "\t\t\t\"name\": \"" << escapeJson(scene.name) << "\",\n";
+		out << "\t\t\t\"initMs\": " << scene.initMs << ",\n";
+		out << "\t\t\t\"cpuFrameMs\": " << scene.cpuFrameMs << ",\n";
+		out << "\t\t\t\"cpuFrameP95Ms\": " << scene.cpuFrameP95Ms << ",\n";
+		if (scene.gpuFrameMs >= 0.0) {
+			out << "\t\t\t\"gpuFrameMs\": " << scene.gpuFrameMs << ",\n";
+		}
+		else {
+			out << "\t\t\t\"gpuFrameMs\": null,\n";
+		}
+		out << "\t\t\t\"hostAllocsPerFrame\": " << scene.hostAllocsPerFrame << ",\n";
+		out << "\t\t\t\"deviceAllocations\": " << scene.deviceAllocations << ",\n";
+		out << "\t\t\t\"deviceMemoryMB\": " << scene.deviceMemoryMB;
+		if (!scene.imageHash.empty()) {
+			out << ",\n\t\t\t\"imageHash\": \"" << scene.imageHash << "\"";
+		}
+		out << "\n\t\t}";
+	}
+
+	out << "\n\t]\n}\n";
+}
+
+Report readReport(const std::string& filen) {
+	std::ifstream file(filen);
+
+	if (!file.is_open()) {
+		ERROR("Failed to open file '" + filen + "'!");
+	}
+
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	std::string text = buffer.str();
+
+	JsonValue root = JsonParser(text).parse();
+	if (root.type != JsonValue::OBJECT) {
+		ERROR("'" + filen + "' is not a benchmark report!");
+	}
+
+	Report report;
+	report.device = root.getString("device");
+	report.mathBackend = root.getString("mathBackend");
+	report.width = static_cast<int>(root.getNumber("width", 0));
+	report.height = static_cast<int>(root.getNumber("height", 0));
+	report.frames = static_cast<int>(root.getNumber("frames", 0));
+
+	const JsonValue* scenes = root.find("scenes");
+	if (scenes && scenes->type == JsonValue::ARRAY) {
+		for (const JsonValue& value : scenes->array) {
+			SceneResult scene;
+			scene.name = value.getString("name");
+			scene.initMs = value.getNumber("initMs", 0.0);
+			scene.cpuFrameMs = value.getNumber("cpuFrameMs", 0.0);
+			scene.cpuFrameP95Ms = value.getNumber("cpuFrameP95Ms", 0.0);
+			scene.gpuFrameMs = value.getNumber("gpuFrameMs", -1.0);
+			scene.hostAllocsPerFrame = value.getNumber("hostAllocsPerFrame", 0.0);
+			scene.deviceAllocations = value.getNumber("deviceAllocations", 0.0);
+			scene.deviceMemoryMB = value.getNumber("deviceMemoryMB", -1.0);
+			scene.imageHash = value.getString("imageHash");
+			report.scenes.push_back(scene);
+		}
+	}
+
+	return report;
+}
+
+std::vector<std::string> compareReports(const Report& baseline, const Report& current, double threshold) {
+	std::vector<std::string> regressions;
+
+	// Everything the baseline covered has to be covered again, otherwise a
+	// broken measurement would pass the gate.
+	for (const SceneResult& scene : baseline.scenes) {
+		const SceneResult* before = &scene;
+		const SceneResult* now = nullptr;
+		for (const SceneResult& other : current.scenes) {
+			if (other.name == scene.name) now = &other;
+		}
+		if (!now) {
+			regressions.push_back(scene.name + ": missing from this run");
+			continue;
+		}
+
+		auto check = [&](const char* metric, double was, double is) {
+			// A metric the baseline couldn't measure has nothing to regress from.
+			if (was < 0.0) return;
+
+			if (is < 0.0) {
+				regressions.push_back(now->name + "." + metric + ": not measured in this run");
+				return;
+			}
+
+			if (is > was * (1.0 + threshold) + 1e-6) {
+				std::ostringstream line;
+				line << std::fixed << std::setprecision(3) << now->name << "." << metric << ": " << was << " -> " << is;
+				if (was > 0.0) line << " (+" << std::setprecision(1) << (is / was - 1.0) * 100.0 << "%)";
+				regressions.push_back(line.str());
+			}
+		};
+
+		check("initMs", before->initMs, now->initMs);
+		check("cpuFrameMs", before->cpuFrameMs, now->cpuFrameMs);
+		check("cpuFrameP95Ms", before->cpuFrameP95Ms, now->cpuFrameP95Ms);
+		check("gpuFrameMs", before->gpuFrameMs, now->gpuFrameMs);
+		check("hostAllocsPerFrame", before->hostAllocsPerFrame, now->hostAllocsPerFrame);
+		check("deviceAllocations", before->deviceAllocations, now->deviceAllocations);
+		check("deviceMemoryMB", before->deviceMemoryMB, now->deviceMemoryMB);
+
+		if (!before->imageHash.empty()) {
+			if (now->imageHash.empty()) {
+				regressions.push_back(now->name + ".imageHash: not read back in this run (pass --readback)");
+			}
+			else if (before->imageHash != now->imageHash) {
+				regressions.push_back(now->name + ".imageHash: " + before->imageHash + " -> " + now->imageHash);
+			}
+		}
+	}
+
+	return regressions;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Results of one benchmark run, and the JSON form they're stored and
+// compared in. Every metric is "lower is better".
+struct SceneResult
+{
+	std::string name;
+
+	double initMs = 0.0;
+	double cpuFrameMs = 0.0;
+	double cpuFrameP95Ms = 0.0;
+	// Negative when the device has no timestamp support.
+	double gpuFrameMs = -1.0;
+	double hostAllocsPerFrame = 0.0;
+	double deviceAllocations = 0.0;
+	// Tracked by MemoryBudget at the end of the scene, all categories.
+	double deviceMemoryMB = -1.0;
+
+	// FNV-1a of the final frame's pixels, empty without --readback.
+	std::string imageHash;
+};
+
+struct Report
+{
+	std::string device;
+	std::string mathBackend;
+	int width = 0;
+	int height = 0;
+	int frames = 0;
+
+	std::vector<SceneResult> scenes;
+};
+
+void writeReport(std::ostream& out, const Report& report);
+Report readReport(const std::string& filen);
+
+// Returns one line per metric that got worse than `threshold` (a fraction,
+// 0.15 = 15%) relative to the baseline, and per golden hash mismatch.
+// Anything the baseline has that this run lacks counts too: a missing scene,
+// a metric that wasn't measured (negative) or a hash that wasn't read back.
+// Scenes only in the current run have no baseline and are ignored.
+std::vector<std::string> compareReports(const Report& baseline, const Report& current, double threshold);
@@ -0,0 +1,385 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "libs.h"
+#include "TVkR.h"
+#include "Culling.h"
+#include "Report.h"
+
+// Host allocation counting
+#if 1
+// Every operator new in the process goes through here, so frame loops can be
+// checked for allocations. Driver allocations made with malloc aren't seen.
+std::atomic<uint64_t> hostAllocations(0);
+
+void* operator new(size_t size) {
+	hostAllocations++;
+	if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+#endif
+
+// Enough objects that the bounds don't fit in cache, like a real scene.
+const size_t objectCount = 1 << 20;
+const double minSecondsPerRun = 0.5;
+
+struct KernelResult {
+	double objectsPerSecond;
+	size_t visible;
+};
+
+// Runs `kernel` over the whole batch until at least minSecondsPerRun has
+// passed, then reports single-threaded throughput.
+template<class F>
+KernelResult measure(F kernel) {
+	using clock = std::chrono::steady_clock;
+
+	size_t visible = kernel();
+
+	size_t iterations = 0;
+	auto start = clock::now();
+	double elapsed = 0.0;
+	do {
+		visible = kernel();
+		iterations++;
+		elapsed = std::chrono::duration<double>(clock::now() - start).count();
+	} while (elapsed < minSecondsPerRun);
+
+	return { (double)(objectCount * iterations) / elapsed, visible };
+}
+
+void report(const char* isa, const char* kernel, const KernelResult& result) {
+	std::cout << std::left << std::setw(8) << isa << std::setw(20) << kernel
+		<< std::right << std::fixed << std::setprecision(1) << std::setw(10) << result.objectsPerSecond / 1e6 << " M objects/s/core"
+		<< "  (" << result.visible << " visible)" << std::endl;
+}
+
+void runCullBenchmarks() {
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> size(0.5f, 4.0f);
+
+	culling::SphereBounds spheres;
+	culling::BoxBounds boxes;
+	spheres.resize(objectCount);
+	boxes.resize(objectCount);
+	for (size_t i = 0; i < objectCount; i++) {
+		math::vec4 center = math::point(position(rng), position(rng), position(rng));
+		spheres.set(i, center, size(rng));
+		boxes.set(i, center, math::direction(size(rng), size(rng), size(rng)));
+	}
+
+	math::mat4 view = math::mat4::lookAt(math::point(0.0f, 0.0f, 0.0f), math::point(0.0f, 0.0f, -1.0f), math::direction(0.0f, 1.0f, 0.0f));
+	math::mat4 projection = math::mat4::perspective(1.0472f, 16.0f / 9.0f, 0.1f, 150.0f);
+	culling::Frustum frustum = culling::extractFrustum(projection * view);
+
+	math::mat4 model = math::mat4::translation(3.0f, -2.0f, 1.0f) * math::mat4::rotation(math::quat::axisAngle(math::direction(0.0f, 1.0f, 0.0f), 0.3f));
+
+	culling::SphereBounds worldSpheres;
+	culling::BoxBounds worldBoxes;
+	std::vector<uint32_t> visible;
+	visible.reserve(objectCount);
+
+	std::cout << "Culling " << objectCount << " objects, math backend " << TVKR_MATH_BACKEND << std::endl;
+
+	culling::InstructionSet best = culling::getInstructionSet();
+
+	for (int i = 0; i < (int)culling::InstructionSet::COUNT; i++) {
+		culling::InstructionSet set = (culling::InstructionSet)i;
+		if (!culling::isSupported(set)) continue;
+
+		culling::setInstructionSet(set);
+		const char* name = culling::getName(set);
+
+		report(name, "cull spheres", measure([&]() {
+			culling::cull(frustum, spheres, visible);
+			return visible.size();
+		}));
+		report(name, "cull boxes", measure([&]() {
+			culling::cull(frustum, boxes, visible);
+			return visible.size();
+		}));
+		report(name, "transform+cull sph", measure([&]() {
+			culling::transform(model, spheres, worldSpheres);
+			culling::cull(frustum, worldSpheres, visible);
+			return visible.size();
+		}));
+		report(name, "transform+cull box", measure([&]() {
+			culling::transform(model, boxes, worldBoxes);
+			culling::cull(frustum, worldBoxes, visible);
+			return visible.size();
+		}));
+	}
+
+	culling::setInstructionSet(best);
+}
+
+// Scene benchmarks
+#if 1
+struct Scene {
+	const char* name;
+	SceneParams params;
+	float renderScale;
+};
+
+// Fixed workloads, so numbers are comparable between runs: one cheap frame,
+// a draw call heavy frame for CPU submission cost, and an overdraw heavy
+// frame for fill rate, also at half resolution with upscaling. Dynamic
+// resolution isn't used since it would make the work depend on timings.
+const Scene scenes[] = {
+	{ "triangle", { 1, 1 }, 1.0f },
+	{ "many-draws", { 4096, 1 }, 1.0f },
+	{ "overdraw", { 1, 256 }, 1.0f },
+	{ "overdraw-half", { 1, 256 }, 0.5f },
+};
+
+const int benchWidth = 640;
+const int benchHeight = 360;
+const int warmupFrames = 16;
+const int defaultFrames = 128;
+
+// 64 bit FNV-1a, as hex.
+std::string hashPixels(const std::vector<uint8_t>& pixels) {
+	uint64_t hash = 14695981039346656037ull;
+	for (uint8_t byte : pixels) {
+		hash ^= byte;
+		hash *= 1099511628211ull;
+	}
+
+	std::ostringstream out;
+	out << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return out.str();
+}
+
+SceneResult runScene(const Scene& scene, int frames, bool readback, std::string& deviceName) {
+	using clock = std::chrono::steady_clock;
+
+	SceneResult result;
+	result.name = scene.name;
+
+	auto initStart = clock::now();
+
+	VkApplication app(benchWidth, benchHeight, ENGINE_FULL_NAME_STR + " Benchmark", Version(1, 0, 0), true);
+	// Prefer a software ICD such as lavapipe: its results only depend on
+	// the CPU, so they stay comparable across machines and CI runners.
+	app.setPreferredDeviceType(VK_PHYSICAL_DEVICE_TYPE_CPU);
+	app.setScene(scene.params);
+	app.setRenderScale(scene.renderScale);
+	app.init();
+
+	result.initMs = std::chrono::duration<double, std::milli>(clock::now() - initStart).count();
+	deviceName = app.getDeviceName();
+
+	for (int i = 0; i < warmupFrames; i++) {
+		app.drawFrame();
+	}
+
+	std::vector<double> cpuTimes(frames);
+	double gpuTotal = 0.0;
+	int gpuSamples = 0;
+
+	uint64_t allocationsBefore = hostAllocations;
+
+	for (int i = 0; i < frames; i++) {
+		auto frameStart = clock::now();
+		app.drawFrame();
+		cpuTimes[i] = std::chrono::duration<double, std::milli>(clock::now() - frameStart).count();
+
+		double gpuTime = app.getLastGPUTime();
+		if (gpuTime >= 0.0) {
+			gpuTotal += gpuTime;
+			gpuSamples++;
+		}
+	}
+
+	result.hostAllocsPerFrame = (double)(hostAllocations - allocationsBefore) / frames;
+
+	app.waitIdle();
+
+	double cpuTotal = 0.0;
+	for (double time : cpuTimes) cpuTotal += time;
+	result.cpuFrameMs = cpuTotal / frames;
+
+	std::sort(cpuTimes.begin(), cpuTimes.end());
+	result.cpuFrameP95Ms = cpuTimes[std::min<size_t>(cpuTimes.size() - 1, cpuTimes.size() * 95 / 100)];
+
+	result.gpuFrameMs = gpuSamples ? gpuTotal / gpuSamples : -1.0;
+	result.deviceAllocations = app.getDeviceAllocationCount();
+
+	MemoryBudget& budget = app.getMemoryBudget();
+	VkDeviceSize deviceMemory = 0;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryCategory::COUNT); i++) {
+		deviceMemory += budget.getCategoryUsage(static_cast<MemoryCategory>(i));
+	}
+	result.deviceMemoryMB = deviceMemory / (1024.0 * 1024.0);
+
+	if (readback) {
+		std::vector<uint8_t> pixels;
+		app.readbackFrame(pixels);
+		result.imageHash = hashPixels(pixels);
+	}
+
+	return result;
+}
+
+void printScene(const SceneResult& result) {
+	std::cout << std::left << std::setw(12) << result.name << std::right << std::fixed << std::setprecision(3)
+		<< " init " << std::setw(9) << result.initMs << " ms"
+		<< "  cpu " << std::setw(8) << result.cpuFrameMs << " ms (p95 " << result.cpuFrameP95Ms << ")";
+
+	if (result.gpuFrameMs >= 0.0) {
+		std::cout << "  gpu " << std::setw(8) << result.gpuFrameMs << " ms";
+	}
+	else {
+		std::cout << "  gpu      n/a";
+	}
+
+	std::cout << "  " << std::setprecision(2) << result.hostAllocsPerFrame << " allocs/frame, "
+		<< result.deviceAllocations << " device allocs, " << result.deviceMemoryMB << " MB";
+
+	if (!result.imageHash.empty()) {
+		std::cout << "  " << result.imageHash;
+	}
+
+	std::cout << std::endl;
+}
+#endif
+
+void printUsage() {
+	std::cerr << "Usage: Benchmark [--cull] [--frames <n>] [--readback] [--out <report.json>]" << std::endl
+		<< "                 [--baseline <report.json>] [--threshold <fraction>] [--allow-mismatch]" << std::endl
+		<< std::endl
+		<< "Renders fixed scenes offscreen, preferring a CPU device (lavapipe), and" << std::endl
+		<< "exits with a failure code when a metric is more than threshold (default" << std::endl
+		<< "0.15) worse than the baseline, a golden image hash doesn't match, or a" << std::endl
+		<< "scene, metric or hash in the baseline is missing from this run." << std::endl
+		<< "A baseline from another device or resolution fails too, unless" << std::endl
+		<< "--allow-mismatch is given, which skips the comparison instead." << std::endl
+		<< "Run from the directory containing shaders/." << std::endl;
+}
+
+int main(int argc, char** argv) {
+	bool cull = false;
+	bool readback = false;
+	bool allowMismatch = false;
+	int frames = defaultFrames;
+	double threshold = 0.15;
+	std::string outFile;
+	std::string baselineFile;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--cull") cull = true;
+		else if (arg == "--readback") readback = true;
+		else if (arg == "--allow-mismatch") allowMismatch = true;
+		else if (arg == "--frames" && hasValue) frames = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--threshold" && hasValue) threshold = std::atof(argv[++i]);
+		else if (arg == "--out" && hasValue) outFile = argv[++i];
+		else if (arg == "--baseline" && hasValue) baselineFile = argv[++i];
+		else {
+			printUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	int exit = EXIT_SUCCESS;
+
+	try {
+		if (cull) {
+			runCullBenchmarks();
+			return exit;
+		}
+
+		Report report;
+		report.mathBackend = TVKR_MATH_BACKEND;
+		report.width = benchWidth;
+		report.height = benchHeight;
+		report.frames = frames;
+
+		for (const Scene& scene : scenes) {
+			SceneResult result = runScene(scene, frames, readback, report.device);
+			printScene(result);
+			report.scenes.push_back(result);
+		}
+
+		std::cout << "Device: " << report.device << std::endl;
+
+		if (!outFile.empty()) {
+			std::ofstream out(outFile);
+			if (!out.is_open()) {
+				ERROR("Failed to open file '" + outFile + "'!");
+			}
+			writeReport(out, report);
+		}
+
+		if (!baselineFile.empty()) {
+			Report baseline = readReport(baselineFile);
+
+			// Timings and images from a different device say nothing about
+			// this build. That still fails by default, so a driver update
+			// can't quietly turn the gate off.
+			if (baseline.device != report.device || baseline.width != report.width || baseline.height != report.height) {
+				std::cout << "Baseline was recorded on '" << baseline.device << "' at " << baseline.width << "x" << baseline.height
+					<< ", this run on '" << report.device << "' at " << report.width << "x" << report.height << "." << std::endl;
+
+				if (allowMismatch) {
+					std::cout << "Not comparing (--allow-mismatch)." << std::endl;
+				}
+				else {
+					std::cout << "Record a new baseline, or pass --allow-mismatch to skip the comparison." << std::endl;
+					exit = EXIT_FAILURE;
+				}
+			}
+			else {
+				std::vector<std::string> regressions = compareReports(baseline, report, threshold);
+
+				for (const std::string& regression : regressions) {
+					std::cout << "REGRESSION " << regression << std::endl;
+				}
+
+				if (!regressions.empty()) {
+					exit = EXIT_FAILURE;
+				}
+				else {
+					std::cout << "No regressions beyond " << threshold * 100.0 << "%." << std::endl;
+				}
+			}
+		}
+	}
+	catch (const ERROR_TYPE& e) {
+		std::cerr << e.what() << std::endl;
+		exit = EXIT_FAILURE;
+	}
+
+	return exit;
+}
@@ -0,0 +1,160 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include <cstdlib>
+
+#include "libs.h"
+#include "MeshOptimizer.h"
+#include "MeshFile.h"
+
+// Minimal Wavefront OBJ reader: positions, normals, UVs and polygon faces
+// (fanned into triangles). Each distinct v/vt/vn combination becomes one
+// vertex, in file order, so the "before" numbers reflect the source mesh.
+void loadObj(const std::string& filen, std::vector<mesh::Vertex>& vertices, std::vector<uint32_t>& indices) {
+	std::ifstream file(filen);
+
+	if (!file.is_open()) {
+		ERROR("Failed to open file '" + filen + "'!");
+	}
+
+	std::vector<std::array<float, 3>> positions;
+	std::vector<std::array<float, 3>> normals;
+	std::vector<std::array<float, 2>> uvs;
+	std::map<std::tuple<int, int, int>, uint32_t> unique;
+
+	// OBJ indices are 1-based, and negative ones count back from the end.
+	auto resolve = [&](const std::string& text, size_t count) {
+		char* end = nullptr;
+		long index = std::strtol(text.c_str(), &end, 10);
+		long resolved = index < 0 ? static_cast<long>(count) + index : index - 1;
+
+		if (text.empty() || *end != '\0' || index == 0 || resolved < 0 || resolved >= static_cast<long>(count)) {
+			ERROR("Invalid face index '" + text + "' in '" + filen + "'!");
+		}
+		return static_cast<int>(resolved);
+	};
+
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream in(line);
+		std::string type;
+		in >> type;
+
+		if (type == "v") {
+			std::array<float, 3> p = {};
+			in >> p[0] >> p[1] >> p[2];
+			positions.push_back(p);
+		}
+		else if (type == "vn") {
+			std::array<float, 3> n = {};
+			in >> n[0] >> n[1] >> n[2];
+			normals.push_back(n);
+		}
+		else if (type == "vt") {
+			std::array<float, 2> t = {};
+			in >> t[0] >> t[1];
+			// OBJ puts the UV origin at the bottom left, Vulkan at the top left.
+			t[1] = 1.0f - t[1];
+			uvs.push_back(t);
+		}
+		else if (type == "f") {
+			std::vector<uint32_t> face;
+			std::string corner;
+
+			while (in >> corner) {
+				size_t first = corner.find('/');
+				size_t second = first == std::string::npos ? std::string::npos : corner.find('/', first + 1);
+
+				int pi = resolve(corner.substr(0, first), positions.size());
+				int ti = -1, ni = -1;
+				if (first != std::string::npos && second != first + 1) {
+					ti = resolve(corner.substr(first + 1, second - first - 1), uvs.size());
+				}
+				if (second != std::string::npos) {
+					ni = resolve(corner.substr(second + 1), normals.size());
+				}
+
+				auto key = std::make_tuple(pi, ti, ni);
+				auto found = unique.find(key);
+				if (found == unique.end()) {
+					mesh::Vertex vertex = {};
+					for (int c = 0; c < 3; c++) vertex.position[c] = positions[pi][c];
+					if (ni >= 0) for (int c = 0; c < 3; c++) vertex.normal[c] = normals[ni][c];
+					if (ti >= 0) for (int c = 0; c < 2; c++) vertex.uv[c] = uvs[ti][c];
+
+					found = unique.emplace(key, static_cast<uint32_t>(vertices.size())).first;
+					vertices.push_back(vertex);
+				}
+				face.push_back(found->second);
+			}
+
+			for (size_t i = 2; i < face.size(); i++) {
+				indices.push_back(face[0]);
+				indices.push_back(face[i - 1]);
+				indices.push_back(face[i]);
+			}
+		}
+	}
+}
+
+void printStats(const char* label, const mesh::MeshStats& stats) {
+	std::cout << std::left << std::setw(8) << label << std::right
+		<< std::setw(10) << stats.vertexBytes << " B vertices  "
+		<< std::setw(10) << stats.indexBytes << " B indices  "
+		<< std::setw(10) << stats.vertexShaderInvocations << " VS invocations  "
+		<< std::fixed << std::setprecision(3)
+		<< "ACMR " << stats.acmr() << "  ATVR " << stats.atvr() << std::endl;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "Usage: MeshPacker <input.obj> <output.tvkm> [--meshlets]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::string input = argv[1];
+	std::string output = argv[2];
+	bool meshlets = argc > 3 && std::string(argv[3]) == "--meshlets";
+
+	int exit = EXIT_SUCCESS;
+
+	try {
+		std::vector<mesh::Vertex> vertices;
+		std::vector<uint32_t> indices;
+		loadObj(input, vertices, indices);
+
+		std::cout << input << ": " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles, "
+			<< "post-transform cache of " << mesh::defaultCacheSize << " entries" << std::endl;
+
+		printStats("before", mesh::analyze(indices, vertices.size(), sizeof(mesh::Vertex), sizeof(uint32_t)));
+
+		mesh::optimizeVertexCache(indices, vertices.size());
+		mesh::optimizeVertexFetch(vertices, indices);
+
+		mesh::PackedMesh packed = mesh::quantize(vertices, indices);
+		if (meshlets) {
+			mesh::buildMeshlets(packed, vertices, indices);
+		}
+
+		size_t indexSize = packed.indices16.empty() ? sizeof(uint32_t) : sizeof(uint16_t);
+		printStats("after", mesh::analyze(indices, packed.vertices.size(), sizeof(mesh::PackedVertex), indexSize));
+
+		if (meshlets) {
+			std::cout << packed.meshlets.size() << " meshlets, "
+				<< std::fixed << std::setprecision(1) << (float)indices.size() / 3 / std::max<size_t>(packed.meshlets.size(), 1) << " triangles and "
+				<< (float)packed.meshletVertices.size() / std::max<size_t>(packed.meshlets.size(), 1) << " vertices each on average" << std::endl;
+		}
+
+		mesh::writeMeshFile(output, packed);
+	}
+	catch (const ERROR_TYPE& e) {
+		std::cerr << e.what() << std::endl;
+		exit = EXIT_FAILURE;
+	}
+
+	return exit;
+}
@@ -0,0 +1,467 @@
+#include "BindlessTable.h"
+
+#include <algorithm>
+
+// How many of each resource we ask for when the device allows it.
+const uint32_t desiredSampledImages = 16384;
+const uint32_t desiredStorageBuffers = 4096;
+const uint32_t desiredSamplers = 256;
+
+// Enough for a handful of resource indices per draw; the spec guarantees 128.
+const uint32_t pushConstantSize = 128;
+
+const VkDescriptorType bindingTypes[BindlessTable::BINDING_COUNT] = {
+	VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+	VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+	VK_DESCRIPTOR_TYPE_SAMPLER
+};
+
+// Sampled images and storage buffers also count towards a per stage limit on
+// all resources (samplers don't). Scales both down evenly to fit `budget`.
+void fitStageBudget(uint32_t& sampledImages, uint32_t& storageBuffers, uint32_t budget) {
+	uint64_t total = uint64_t(sampledImages) + storageBuffers;
+	if (total <= budget) return;
+
+	sampledImages = static_cast<uint32_t>(uint64_t(sampledImages) * budget / total);
+	storageBuffers = budget - sampledImages;
+}
+
+BindlessTable::BindlessTable()
+{
+}
+
+BindlessTable::~BindlessTable()
+{
+	destroy();
+}
+
+void BindlessTable::create(VkDevice dev, const DescriptorIndexingSupport& support, const VkPhysicalDeviceLimits& limits, MemoryBudget* b)
+{
+	device = dev;
+	budget = b;
+	bindless = support.supported;
+
+	if (bindless) {
+		slots[SAMPLED_IMAGES].capacity = std::min(desiredSampledImages, support.maxSampledImages);
+		slots[STORAGE_BUFFERS].capacity = std::min(desiredStorageBuffers, support.maxStorageBuffers);
+		slots[SAMPLERS].capacity = std::min(desiredSamplers, support.maxSamplers);
+	}
+	else {
+		slots[SAMPLED_IMAGES].capacity = std::min(desiredSampledImages, std::min(limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSampledImages));
+		slots[STORAGE_BUFFERS].capacity = std::min(desiredStorageBuffers, std::min(limits.maxPerStageDescriptorStorageBuffers, limits.maxDescriptorSetStorageBuffers));
+		slots[SAMPLERS].capacity = std::min(desiredSamplers, std::min(limits.maxPerStageDescriptorSamplers, limits.maxDescriptorSetSamplers));
+	}
+
+	// Leave room for the color attachments, which count towards it too.
+	uint32_t stageBudget = bindless ? support.maxPerStageResources : limits.maxPerStageResources;
+	stageBudget -= std::min(stageBudget, limits.maxColorAttachments);
+	fitStageBudget(slots[SAMPLED_IMAGES].capacity, slots[STORAGE_BUFFERS].capacity, stageBudget);
+
+	VkDescriptorSetLayoutBinding bindings[BINDING_COUNT] = {};
+	VkDescriptorPoolSize poolSizes[BINDING_COUNT] = {};
+	for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = bindingTypes[i];
+		bindings[i].descriptorCount = slots[i].capacity;
+		bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+
+		poolSizes[i].type = bindingTypes[i];
+		poolSizes[i].descriptorCount = slots[i].capacity;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = BINDING_COUNT;
+	layoutInfo.pBindings = bindings;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = BINDING_COUNT;
+	poolInfo.pPoolSizes = poolSizes;
+
+#ifdef VK_EXT_descriptor_indexing
+	VkDescriptorBindingFlagsEXT bindingFlags[BINDING_COUNT];
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+
+	if (bindless) {
+		for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+			bindingFlags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+		}
+
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = BINDING_COUNT;
+		bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	}
+#endif
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		ERROR("Failed to create bindless descriptor set layout!");
+	}
+
+	VkPushConstantRange pushConstants = {};
+	pushConstants.stageFlags = VK_SHADER_STAGE_ALL;
+	pushConstants.offset = 0;
+	pushConstants.size = pushConstantSize;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstants;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		ERROR("Failed to create bindless pipeline layout!");
+	}
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		ERROR("Failed to create bindless descriptor pool!");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS) {
+		ERROR("Failed to allocate bindless descriptor set!");
+	}
+
+	if (!bindless) {
+		createPlaceholders();
+		for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+			writePlaceholders(static_cast<Binding>(i), 0, slots[i].capacity);
+		}
+	}
+}
+
+uint32_t findPlaceholderMemoryType(const VkPhysicalDeviceMemoryProperties& properties, uint32_t typeFilter) {
+	for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+			return i;
+		}
+	}
+	for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+		if (typeFilter & (1 << i)) return i;
+	}
+
+	ERROR("Failed to find memory for the bindless placeholders!");
+}
+
+void BindlessTable::createPlaceholders()
+{
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	imageInfo.extent = { 1, 1, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (vkCreateImage(device, &imageInfo, nullptr, &placeholderImage) != VK_SUCCESS) {
+		ERROR("Failed to create bindless placeholder image!");
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, placeholderImage, &requirements);
+
+	placeholderImageMemory = budget->allocate(requirements.size, findPlaceholderMemoryType(budget->getMemoryProperties(), requirements.memoryTypeBits), MemoryCategory::TEXTURES);
+	vkBindImageMemory(device, placeholderImage, placeholderImageMemory, 0);
+
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = placeholderImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = imageInfo.format;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	if (vkCreateImageView(device, &viewInfo, nullptr, &placeholderView) != VK_SUCCESS) {
+		ERROR("Failed to create bindless placeholder image view!");
+	}
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = 16;
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &placeholderBuffer) != VK_SUCCESS) {
+		ERROR("Failed to create bindless placeholder buffer!");
+	}
+
+	vkGetBufferMemoryRequirements(device, placeholderBuffer, &requirements);
+
+	placeholderBufferMemory = budget->allocate(requirements.size, findPlaceholderMemoryType(budget->getMemoryProperties(), requirements.memoryTypeBits), MemoryCategory::GEOMETRY);
+	vkBindBufferMemory(device, placeholderBuffer, placeholderBufferMemory, 0);
+
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = 0.0f;
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &placeholderSampler) != VK_SUCCESS) {
+		ERROR("Failed to create bindless placeholder sampler!");
+	}
+}
+
+BindlessTable::PendingWrite BindlessTable::getPlaceholderWrite(Binding binding, Handle handle)
+{
+	PendingWrite write = {};
+	write.binding = binding;
+	write.handle = handle;
+	write.image.imageView = binding == SAMPLED_IMAGES ? placeholderView : VK_NULL_HANDLE;
+	write.image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	write.image.sampler = binding == SAMPLERS ? placeholderSampler : VK_NULL_HANDLE;
+	write.buffer.buffer = placeholderBuffer;
+	write.buffer.offset = 0;
+	write.buffer.range = VK_WHOLE_SIZE;
+	return write;
+}
+
+void BindlessTable::writePlaceholders(Binding binding, uint32_t first, uint32_t count)
+{
+	if (count == 0) return;
+
+	PendingWrite write = getPlaceholderWrite(binding, first);
+	std::vector<VkDescriptorImageInfo> images(count, write.image);
+	std::vector<VkDescriptorBufferInfo> buffers(count, write.buffer);
+
+	VkWriteDescriptorSet descriptorWrite = {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = set;
+	descriptorWrite.dstBinding = binding;
+	descriptorWrite.dstArrayElement = first;
+	descriptorWrite.descriptorCount = count;
+	descriptorWrite.descriptorType = bindingTypes[binding];
+
+	if (binding == STORAGE_BUFFERS) {
+		descriptorWrite.pBufferInfo = buffers.data();
+	}
+	else {
+		descriptorWrite.pImageInfo = images.data();
+	}
+
+	vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+void BindlessTable::recordSetup(VkCommandBuffer commandBuffer)
+{
+	if (placeholderImage == VK_NULL_HANDLE) return;
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = placeholderImage;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	// Reads of an unused slot come back as transparent black.
+	VkClearColorValue black = {};
+	vkCmdClearColorImage(commandBuffer, placeholderImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &barrier.subresourceRange);
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void BindlessTable::destroy()
+{
+	if (device == VK_NULL_HANDLE) return;
+
+	// The set is freed along with its pool.
+	vkDestroyDescriptorPool(device, pool, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+
+	vkDestroySampler(device, placeholderSampler, nullptr);
+	vkDestroyBuffer(device, placeholderBuffer, nullptr);
+	vkDestroyImageView(device, placeholderView, nullptr);
+	vkDestroyImage(device, placeholderImage, nullptr);
+	budget->free(placeholderBufferMemory);
+	budget->free(placeholderImageMemory);
+
+	placeholderSampler = VK_NULL_HANDLE;
+	placeholderBuffer = VK_NULL_HANDLE;
+	placeholderBufferMemory = VK_NULL_HANDLE;
+	placeholderView = VK_NULL_HANDLE;
+	placeholderImage = VK_NULL_HANDLE;
+	placeholderImageMemory = VK_NULL_HANDLE;
+
+	pool = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+	set = VK_NULL_HANDLE;
+
+	for (auto& slot : slots) {
+		slot = Slots();
+	}
+	pending.clear();
+
+	device = VK_NULL_HANDLE;
+}
+
+BindlessTable::Handle BindlessTable::allocate(Binding binding)
+{
+	Slots& slot = slots[binding];
+
+	Handle handle;
+	if (!slot.freeList.empty()) {
+		handle = slot.freeList.back();
+		slot.freeList.pop_back();
+	}
+	else if (slot.next < slot.capacity) {
+		handle = slot.next++;
+	}
+	else {
+		ERROR("Bindless table is full!");
+	}
+
+	if (slot.live.size() < slot.capacity) {
+		slot.live.resize(slot.capacity, false);
+	}
+	slot.live[handle] = true;
+
+	return handle;
+}
+
+void BindlessTable::release(Binding binding, Handle handle)
+{
+	if (handle == INVALID_HANDLE) return;
+
+	Slots& slot = slots[binding];
+	if (handle >= slot.live.size() || !slot.live[handle]) {
+		ERROR("Released a bindless handle that isn't allocated!");
+	}
+	slot.live[handle] = false;
+
+	// Drop any write still queued for this slot so a recycled handle can't be
+	// clobbered by its previous owner on the next flush.
+	pending.erase(std::remove_if(pending.begin(), pending.end(), [&](const PendingWrite& write) {
+		return write.binding == binding && write.handle == handle;
+	}), pending.end());
+
+	// The resource may be destroyed now, which would leave the slot invalid.
+	if (!bindless) {
+		pending.push_back(getPlaceholderWrite(binding, handle));
+	}
+
+	slot.freeList.push_back(handle);
+}
+
+BindlessTable::Handle BindlessTable::addSampledImage(VkImageView view, VkImageLayout layout)
+{
+	PendingWrite write = {};
+	write.binding = SAMPLED_IMAGES;
+	write.handle = allocate(SAMPLED_IMAGES);
+	write.image.imageView = view;
+	write.image.imageLayout = layout;
+
+	pending.push_back(write);
+	return write.handle;
+}
+
+BindlessTable::Handle BindlessTable::addStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	PendingWrite write = {};
+	write.binding = STORAGE_BUFFERS;
+	write.handle = allocate(STORAGE_BUFFERS);
+	write.buffer.buffer = buffer;
+	write.buffer.offset = offset;
+	write.buffer.range = range;
+
+	pending.push_back(write);
+	return write.handle;
+}
+
+BindlessTable::Handle BindlessTable::addSampler(VkSampler sampler)
+{
+	PendingWrite write = {};
+	write.binding = SAMPLERS;
+	write.handle = allocate(SAMPLERS);
+	write.image.sampler = sampler;
+
+	pending.push_back(write);
+	return write.handle;
+}
+
+// The caller has to make sure no in-flight frame still indexes a handle
+// before removing it, since the slot can be handed out again right away.
+void BindlessTable::removeSampledImage(Handle handle)
+{
+	release(SAMPLED_IMAGES, handle);
+}
+
+void BindlessTable::removeStorageBuffer(Handle handle)
+{
+	release(STORAGE_BUFFERS, handle);
+}
+
+void BindlessTable::removeSampler(Handle handle)
+{
+	release(SAMPLERS, handle);
+}
+
+void BindlessTable::flush()
+{
+	if (pending.empty()) return;
+
+	std::vector<VkWriteDescriptorSet> writes(pending.size());
+	for (size_t i = 0; i < pending.size(); i++) {
+		const PendingWrite& write = pending[i];
+
+		writes[i] = {};
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = set;
+		writes[i].dstBinding = write.binding;
+		writes[i].dstArrayElement = write.handle;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = bindingTypes[write.binding];
+
+		if (write.binding == STORAGE_BUFFERS) {
+			writes[i].pBufferInfo = &write.buffer;
+		}
+		else {
+			writes[i].pImageInfo = &write.image;
+		}
+	}
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	pending.clear();
+}
+
+void BindlessTable::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint)
+{
+	vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, 0, 1, &set, 0, nullptr);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "libs.h"
+#include "MemoryBudget.h"
+
+#include <vector>
+
+// What the physical device can do for bindless descriptors. Filled in by
+// pickDevice() and consumed by createLogicalDevice() and BindlessTable.
+struct DescriptorIndexingSupport
+{
+	bool supported = false;
+
+	uint32_t maxSampledImages = 0;
+	uint32_t maxStorageBuffers = 0;
+	uint32_t maxSamplers = 0;
+	// Shared by sampled images, storage buffers and color attachments.
+	uint32_t maxPerStageResources = 0;
+};
+
+// One global descriptor set holding every sampled image, storage buffer and
+// sampler the engine knows about. Resources are referred to by a stable index
+// into their array, so a draw only needs the set bound once per frame and
+// selects resources with push constants or per-draw data.
+//
+// With VK_EXT_descriptor_indexing the arrays are large, partially bound and
+// UPDATE_AFTER_BIND, so slots can be written while the set is in use. Without
+// it the same bindings are created with the classic limits, and writes are
+// only legal while no submitted command buffer uses the set; shaders then
+// have to declare the arrays with the fixed sizes from getCapacity(). Those
+// bindings aren't partially bound either, so every free slot points at a
+// placeholder image, buffer or sampler.
+class BindlessTable
+{
+public:
+	typedef uint32_t Handle;
+	static const Handle INVALID_HANDLE = 0xFFFFFFFF;
+
+	enum Binding : uint32_t {
+		SAMPLED_IMAGES = 0,
+		STORAGE_BUFFERS = 1,
+		SAMPLERS = 2,
+		BINDING_COUNT
+	};
+
+	BindlessTable();
+	~BindlessTable();
+
+	// The placeholders are allocated through `budget`, which must outlive
+	// this.
+	void create(VkDevice device, const DescriptorIndexingSupport& support, const VkPhysicalDeviceLimits& limits, MemoryBudget* budget);
+	void destroy();
+
+	// Clears the placeholder image and moves it to SHADER_READ_ONLY_OPTIMAL.
+	// Has to run before the first draw; records nothing with descriptor
+	// indexing.
+	void recordSetup(VkCommandBuffer commandBuffer);
+
+	Handle addSampledImage(VkImageView view, VkImageLayout layout);
+	Handle addStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+	Handle addSampler(VkSampler sampler);
+
+	// Throws on a handle that isn't currently allocated from that binding.
+	void removeSampledImage(Handle handle);
+	void removeStorageBuffer(Handle handle);
+	void removeSampler(Handle handle);
+
+	// Pushes all queued slot writes to the descriptor set in one call.
+	void flush();
+
+	// The one descriptor bind a frame needs.
+	void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint);
+
+	bool isBindless() { return bindless; }
+	bool hasPendingWrites() { return !pending.empty(); }
+	uint32_t getCapacity(Binding binding) { return slots[binding].capacity; }
+
+	VkDescriptorSetLayout getSetLayout() { return setLayout; }
+	VkPipelineLayout getPipelineLayout() { return pipelineLayout; }
+	VkDescriptorSet getSet() { return set; }
+
+private:
+
+	struct Slots {
+		uint32_t capacity = 0;
+		uint32_t next = 0;
+		std::vector<Handle> freeList;
+		// Indexed by handle, sized on first use.
+		std::vector<bool> live;
+	};
+
+	struct PendingWrite {
+		Binding binding;
+		Handle handle;
+		VkDescriptorImageInfo image;
+		VkDescriptorBufferInfo buffer;
+	};
+
+	Handle allocate(Binding binding);
+	void release(Binding binding, Handle handle);
+
+	void createPlaceholders();
+	// Points slots [first, first + count) at the placeholder.
+	void writePlaceholders(Binding binding, uint32_t first, uint32_t count);
+	PendingWrite getPlaceholderWrite(Binding binding, Handle handle);
+
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryBudget* budget = nullptr;
+	bool bindless = false;
+
+	Slots slots[BINDING_COUNT];
+	std::vector<PendingWrite> pending;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+
+	// Only created without descriptor indexing.
+	VkImage placeholderImage = VK_NULL_HANDLE;
+	VkDeviceMemory placeholderImageMemory = VK_NULL_HANDLE;
+	VkImageView placeholderView = VK_NULL_HANDLE;
+	VkBuffer placeholderBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory placeholderBufferMemory = VK_NULL_HANDLE;
+	VkSampler placeholderSampler = VK_NULL_HANDLE;
+
+};
@@ -0,0 +1,220 @@
+#include "Culling.h"
+#include "libs.h"
+
+#include "CullingKernels.inl"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CULLING_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+const culling::detail::Kernels* culling::detail::getScalarKernels()
+{
+	return KernelSet<ScalarLane>::get();
+}
+
+#ifdef CULLING_X86
+static bool cpuSupportsAVX2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+
+	// The OS also has to save the upper halves of the YMM registers.
+	if (!osxsave || !avx || !fma || (_xgetbv(0) & 0x6) != 0x6) return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+static const culling::detail::Kernels* getKernels(culling::InstructionSet set) {
+	using namespace culling;
+
+	switch (set) {
+	case InstructionSet::SCALAR:
+		return detail::getScalarKernels();
+	case InstructionSet::SSE:
+		return detail::getSSEKernels();
+	case InstructionSet::AVX2:
+#ifdef CULLING_X86
+		if (!cpuSupportsAVX2()) return nullptr;
+#endif
+		return detail::getAVX2Kernels();
+	case InstructionSet::NEON:
+		return detail::getNEONKernels();
+	default:
+		return nullptr;
+	}
+}
+
+static culling::InstructionSet pickInstructionSet() {
+	using namespace culling;
+
+	const InstructionSet preferred[] = { InstructionSet::AVX2, InstructionSet::NEON, InstructionSet::SSE };
+	for (InstructionSet set : preferred) {
+		if (getKernels(set) != nullptr) return set;
+	}
+
+	return InstructionSet::SCALAR;
+}
+
+static culling::InstructionSet activeSet = pickInstructionSet();
+static const culling::detail::Kernels* activeKernels = getKernels(activeSet);
+
+const char* culling::getName(InstructionSet set)
+{
+	switch (set) {
+	case InstructionSet::SCALAR: return "scalar";
+	case InstructionSet::SSE: return "SSE";
+	case InstructionSet::AVX2: return "AVX2";
+	case InstructionSet::NEON: return "NEON";
+	default: return "unknown";
+	}
+}
+
+bool culling::isSupported(InstructionSet set)
+{
+	return getKernels(set) != nullptr;
+}
+
+culling::InstructionSet culling::getInstructionSet()
+{
+	return activeSet;
+}
+
+void culling::setInstructionSet(InstructionSet set)
+{
+	const detail::Kernels* kernels = getKernels(set);
+	if (kernels == nullptr) {
+		ERROR(std::string("Culling instruction set '") + getName(set) + "' is not supported here!");
+	}
+
+	activeSet = set;
+	activeKernels = kernels;
+}
+
+void culling::SphereBounds::resize(size_t count)
+{
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	radius.resize(count);
+}
+
+void culling::SphereBounds::set(size_t i, const math::vec4& center, float r)
+{
+	x[i] = center.x();
+	y[i] = center.y();
+	z[i] = center.z();
+	radius[i] = r;
+}
+
+void culling::BoxBounds::resize(size_t count)
+{
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	extentX.resize(count);
+	extentY.resize(count);
+	extentZ.resize(count);
+}
+
+void culling::BoxBounds::set(size_t i, const math::vec4& center, const math::vec4& extent)
+{
+	x[i] = center.x();
+	y[i] = center.y();
+	z[i] = center.z();
+	extentX[i] = extent.x();
+	extentY[i] = extent.y();
+	extentZ[i] = extent.z();
+}
+
+culling::Frustum culling::extractFrustum(const math::mat4& viewProjection)
+{
+	math::vec4 r0 = viewProjection.row(0);
+	math::vec4 r1 = viewProjection.row(1);
+	math::vec4 r2 = viewProjection.row(2);
+	math::vec4 r3 = viewProjection.row(3);
+
+	math::vec4 planes[6] = {
+		r3 + r0, // left
+		r3 - r0, // right
+		r3 + r1, // top (Y points down in Vulkan clip space)
+		r3 - r1, // bottom
+		r2,      // near, since depth starts at 0
+		r3 - r2  // far
+	};
+
+	Frustum frustum;
+	for (int p = 0; p < 6; p++) {
+		float invLength = 1.0f / math::length3(planes[p]);
+		frustum.nx[p] = planes[p].x() * invLength;
+		frustum.ny[p] = planes[p].y() * invLength;
+		frustum.nz[p] = planes[p].z() * invLength;
+		frustum.d[p] = planes[p].w() * invLength;
+	}
+
+	return frustum;
+}
+
+static float maxAxisScale(const float m[16]) {
+	float sx = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+	float sy = m[4] * m[4] + m[5] * m[5] + m[6] * m[6];
+	float sz = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+	return std::sqrt(std::max(std::max(sx, sy), sz));
+}
+
+void culling::transform(const math::mat4& m, const SphereBounds& in, SphereBounds& out)
+{
+	float matrix[16];
+	m.store(matrix);
+
+	out.resize(in.size());
+
+	const float* const src[4] = { in.x.data(), in.y.data(), in.z.data(), in.radius.data() };
+	float* const dst[4] = { out.x.data(), out.y.data(), out.z.data(), out.radius.data() };
+	activeKernels->transformSpheres(matrix, maxAxisScale(matrix), src, dst, in.size());
+}
+
+void culling::transform(const math::mat4& m, const BoxBounds& in, BoxBounds& out)
+{
+	float matrix[16];
+	m.store(matrix);
+
+	out.resize(in.size());
+
+	const float* const src[6] = { in.x.data(), in.y.data(), in.z.data(), in.extentX.data(), in.extentY.data(), in.extentZ.data() };
+	float* const dst[6] = { out.x.data(), out.y.data(), out.z.data(), out.extentX.data(), out.extentY.data(), out.extentZ.data() };
+	activeKernels->transformBoxes(matrix, src, dst, in.size());
+}
+
+void culling::cull(const Frustum& frustum, const SphereBounds& bounds, std::vector<uint32_t>& visible)
+{
+	visible.resize(bounds.size());
+
+	const float* const src[4] = { bounds.x.data(), bounds.y.data(), bounds.z.data(), bounds.radius.data() };
+	visible.resize(activeKernels->cullSpheres(frustum, src, bounds.size(), visible.data()));
+}
+
+void culling::cull(const Frustum& frustum, const BoxBounds& bounds, std::vector<uint32_t>& visible)
+{
+	visible.resize(bounds.size());
+
+	const float* const src[6] = { bounds.x.data(), bounds.y.data(), bounds.z.data(), bounds.extentX.data(), bounds.extentY.data(), bounds.extentZ.data() };
+	visible.resize(activeKernels->cullBoxes(frustum, src, bounds.size(), visible.data()));
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "TMath.h"
+#include "CullingKernels.h"
+
+#include <vector>
+
+// Batched visibility tests over structure-of-arrays bounds. Every call runs
+// one kernel over the whole batch; which SIMD variant that kernel is gets
+// picked once at startup from what the CPU supports.
+namespace culling {
+
+	enum class InstructionSet {
+		SCALAR,
+		SSE,
+		AVX2,
+		NEON,
+		COUNT
+	};
+
+	const char* getName(InstructionSet set);
+	bool isSupported(InstructionSet set);
+
+	InstructionSet getInstructionSet();
+	// Overrides the automatic choice, mainly so benchmarks can compare them.
+	void setInstructionSet(InstructionSet set);
+
+	struct SphereBounds
+	{
+		std::vector<float> x, y, z, radius;
+
+		size_t size() const { return x.size(); }
+		void resize(size_t count);
+		void set(size_t i, const math::vec4& center, float r);
+	};
+
+	struct BoxBounds
+	{
+		std::vector<float> x, y, z;
+		std::vector<float> extentX, extentY, extentZ;
+
+		size_t size() const { return x.size(); }
+		void resize(size_t count);
+		void set(size_t i, const math::vec4& center, const math::vec4& extent);
+	};
+
+	// Gribb/Hartmann plane extraction, for clip space depth in [0, 1].
+	Frustum extractFrustum(const math::mat4& viewProjection);
+
+	void transform(const math::mat4& m, const SphereBounds& in, SphereBounds& out);
+	void transform(const math::mat4& m, const BoxBounds& in, BoxBounds& out);
+
+	// Fills `visible` with the indices of the bounds that touch the frustum,
+	// in ascending order, ready to drive draw submission.
+	void cull(const Frustum& frustum, const SphereBounds& bounds, std::vector<uint32_t>& visible);
+	void cull(const Frustum& frustum, const BoxBounds& bounds, std::vector<uint32_t>& visible);
+
+}
@@ -0,0 +1,45 @@
+// Built with AVX2 code generation (/arch:AVX2, -mavx2 -mfma). Only entered
+// after Culling.cpp has checked the CPU supports it.
+#include "CullingKernels.inl"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace {
+
+	struct AVX2Lane
+	{
+		typedef __m256 F;
+		typedef __m256 M;
+		static const size_t WIDTH = 8;
+
+		static F load(const float* p) { return _mm256_loadu_ps(p); }
+		static void store(float* p, F v) { _mm256_storeu_ps(p, v); }
+		static F splat(float v) { return _mm256_set1_ps(v); }
+		static F add(F a, F b) { return _mm256_add_ps(a, b); }
+		static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+		static F madd(F a, F b, F c) { return _mm256_fmadd_ps(a, b, c); }
+		static F neg(F a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+		static F abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+		static M ge(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		static M both(M a, M b) { return _mm256_and_ps(a, b); }
+		static M all() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+		static unsigned bits(M m) { return static_cast<unsigned>(_mm256_movemask_ps(m)); }
+	};
+
+}
+
+const culling::detail::Kernels* culling::detail::getAVX2Kernels()
+{
+	return KernelSet<AVX2Lane>::get();
+}
+
+#else
+
+const culling::detail::Kernels* culling::detail::getAVX2Kernels()
+{
+	return nullptr;
+}
+
+#endif
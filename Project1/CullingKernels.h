@@ -0,0 +1,46 @@
+#pragma once
+
+// Shared between Culling.cpp and the per instruction set translation units.
+// Those are built with their own code generation flags, so this header must
+// stay free of anything (std containers, TMath.h) that would emit inline
+// functions which the linker could then pick up compiled for the wrong ISA.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace culling {
+
+	// Six planes as SoA, normals pointing inwards: a point p is inside when
+	// n.p + d >= 0 for all of them.
+	struct Frustum
+	{
+		float nx[6];
+		float ny[6];
+		float nz[6];
+		float d[6];
+	};
+
+	namespace detail {
+
+		// Streams are x, y, z, radius for spheres and x, y, z, extent x, y, z
+		// for boxes. Matrices are column-major. Sphere radii are multiplied by
+		// `radiusScale`, the largest axis scale of the matrix, which the
+		// caller works out so the kernels don't need sqrt. Cull kernels write
+		// up to `count` indices into `visible` and return how many are visible.
+		struct Kernels
+		{
+			void(*transformSpheres)(const float m[16], float radiusScale, const float* const in[4], float* const out[4], size_t count);
+			void(*transformBoxes)(const float m[16], const float* const in[6], float* const out[6], size_t count);
+			size_t(*cullSpheres)(const Frustum& frustum, const float* const in[4], size_t count, uint32_t* visible);
+			size_t(*cullBoxes)(const Frustum& frustum, const float* const in[6], size_t count, uint32_t* visible);
+		};
+
+		// Each returns nullptr when that variant wasn't compiled in.
+		const Kernels* getScalarKernels();
+		const Kernels* getSSEKernels();
+		const Kernels* getAVX2Kernels();
+		const Kernels* getNEONKernels();
+
+	}
+
+}
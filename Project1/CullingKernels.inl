@@ -0,0 +1,205 @@
+#pragma once
+
+// The kernels themselves, written once against a "lane" type that supplies
+// WIDTH floats per register. Only included by Culling.cpp and the
+// Culling<ISA>.cpp files, and kept in an anonymous namespace so every ISA
+// gets a private copy. For the same reason this calls no library functions
+// (not even <cmath>), whose inline definitions would be shared.
+
+#include "CullingKernels.h"
+
+namespace {
+
+	using culling::Frustum;
+
+	struct ScalarLane
+	{
+		typedef float F;
+		typedef bool M;
+		static const size_t WIDTH = 1;
+
+		static F load(const float* p) { return *p; }
+		static void store(float* p, F v) { *p = v; }
+		static F splat(float v) { return v; }
+		static F add(F a, F b) { return a + b; }
+		static F mul(F a, F b) { return a * b; }
+		static F madd(F a, F b, F c) { return a * b + c; }
+		static F neg(F a) { return -a; }
+		static F abs(F a) { return a < 0.0f ? -a : a; }
+		static M ge(F a, F b) { return a >= b; }
+		static M both(M a, M b) { return a && b; }
+		static M all() { return true; }
+		static unsigned bits(M m) { return m ? 1u : 0u; }
+	};
+
+	template<class L>
+	void transformSpheresT(const float m[16], float radiusScale, const float* const in[4], float* const out[4], size_t begin, size_t end) {
+		typedef typename L::F F;
+
+		F m0 = L::splat(m[0]), m1 = L::splat(m[1]), m2 = L::splat(m[2]);
+		F m4 = L::splat(m[4]), m5 = L::splat(m[5]), m6 = L::splat(m[6]);
+		F m8 = L::splat(m[8]), m9 = L::splat(m[9]), m10 = L::splat(m[10]);
+		F m12 = L::splat(m[12]), m13 = L::splat(m[13]), m14 = L::splat(m[14]);
+		F scale = L::splat(radiusScale);
+
+		for (size_t i = begin; i + L::WIDTH <= end; i += L::WIDTH) {
+			F x = L::load(in[0] + i);
+			F y = L::load(in[1] + i);
+			F z = L::load(in[2] + i);
+
+			L::store(out[0] + i, L::madd(m0, x, L::madd(m4, y, L::madd(m8, z, m12))));
+			L::store(out[1] + i, L::madd(m1, x, L::madd(m5, y, L::madd(m9, z, m13))));
+			L::store(out[2] + i, L::madd(m2, x, L::madd(m6, y, L::madd(m10, z, m14))));
+			L::store(out[3] + i, L::mul(L::load(in[3] + i), scale));
+		}
+	}
+
+	// Arvo's method: the new extents are the old ones run through the
+	// absolute value of the upper 3x3.
+	template<class L>
+	void transformBoxesT(const float m[16], const float* const in[6], float* const out[6], size_t begin, size_t end) {
+		typedef typename L::F F;
+
+		F m0 = L::splat(m[0]), m1 = L::splat(m[1]), m2 = L::splat(m[2]);
+		F m4 = L::splat(m[4]), m5 = L::splat(m[5]), m6 = L::splat(m[6]);
+		F m8 = L::splat(m[8]), m9 = L::splat(m[9]), m10 = L::splat(m[10]);
+		F m12 = L::splat(m[12]), m13 = L::splat(m[13]), m14 = L::splat(m[14]);
+		F a0 = L::abs(m0), a1 = L::abs(m1), a2 = L::abs(m2);
+		F a4 = L::abs(m4), a5 = L::abs(m5), a6 = L::abs(m6);
+		F a8 = L::abs(m8), a9 = L::abs(m9), a10 = L::abs(m10);
+
+		for (size_t i = begin; i + L::WIDTH <= end; i += L::WIDTH) {
+			F x = L::load(in[0] + i);
+			F y = L::load(in[1] + i);
+			F z = L::load(in[2] + i);
+			F ex = L::load(in[3] + i);
+			F ey = L::load(in[4] + i);
+			F ez = L::load(in[5] + i);
+
+			L::store(out[0] + i, L::madd(m0, x, L::madd(m4, y, L::madd(m8, z, m12))));
+			L::store(out[1] + i, L::madd(m1, x, L::madd(m5, y, L::madd(m9, z, m13))));
+			L::store(out[2] + i, L::madd(m2, x, L::madd(m6, y, L::madd(m10, z, m14))));
+			L::store(out[3] + i, L::madd(a0, ex, L::madd(a4, ey, L::mul(a8, ez))));
+			L::store(out[4] + i, L::madd(a1, ex, L::madd(a5, ey, L::mul(a9, ez))));
+			L::store(out[5] + i, L::madd(a2, ex, L::madd(a6, ey, L::mul(a10, ez))));
+		}
+	}
+
+	// Appends without branching on the result: every lane writes its index,
+	// and only visible lanes advance the cursor.
+	template<class L>
+	size_t appendVisible(unsigned bits, size_t base, uint32_t* visible, size_t count) {
+		for (size_t lane = 0; lane < L::WIDTH; lane++) {
+			visible[count] = static_cast<uint32_t>(base + lane);
+			count += (bits >> lane) & 1u;
+		}
+		return count;
+	}
+
+	template<class L>
+	size_t cullSpheresT(const Frustum& f, const float* const in[4], size_t begin, size_t end, uint32_t* visible, size_t count) {
+		typedef typename L::F F;
+		typedef typename L::M M;
+
+		F nx[6], ny[6], nz[6], d[6];
+		for (int p = 0; p < 6; p++) {
+			nx[p] = L::splat(f.nx[p]);
+			ny[p] = L::splat(f.ny[p]);
+			nz[p] = L::splat(f.nz[p]);
+			d[p] = L::splat(f.d[p]);
+		}
+
+		for (size_t i = begin; i + L::WIDTH <= end; i += L::WIDTH) {
+			F x = L::load(in[0] + i);
+			F y = L::load(in[1] + i);
+			F z = L::load(in[2] + i);
+			F negRadius = L::neg(L::load(in[3] + i));
+
+			M inside = L::all();
+			for (int p = 0; p < 6; p++) {
+				F dist = L::madd(nx[p], x, L::madd(ny[p], y, L::madd(nz[p], z, d[p])));
+				inside = L::both(inside, L::ge(dist, negRadius));
+			}
+
+			count = appendVisible<L>(L::bits(inside), i, visible, count);
+		}
+
+		return count;
+	}
+
+	template<class L>
+	size_t cullBoxesT(const Frustum& f, const float* const in[6], size_t begin, size_t end, uint32_t* visible, size_t count) {
+		typedef typename L::F F;
+		typedef typename L::M M;
+
+		F nx[6], ny[6], nz[6], ax[6], ay[6], az[6], d[6];
+		for (int p = 0; p < 6; p++) {
+			nx[p] = L::splat(f.nx[p]);
+			ny[p] = L::splat(f.ny[p]);
+			nz[p] = L::splat(f.nz[p]);
+			ax[p] = L::abs(nx[p]);
+			ay[p] = L::abs(ny[p]);
+			az[p] = L::abs(nz[p]);
+			d[p] = L::splat(f.d[p]);
+		}
+
+		for (size_t i = begin; i + L::WIDTH <= end; i += L::WIDTH) {
+			F x = L::load(in[0] + i);
+			F y = L::load(in[1] + i);
+			F z = L::load(in[2] + i);
+			F ex = L::load(in[3] + i);
+			F ey = L::load(in[4] + i);
+			F ez = L::load(in[5] + i);
+
+			M inside = L::all();
+			for (int p = 0; p < 6; p++) {
+				F dist = L::madd(nx[p], x, L::madd(ny[p], y, L::madd(nz[p], z, d[p])));
+				F reach = L::madd(ax[p], ex, L::madd(ay[p], ey, L::mul(az[p], ez)));
+				inside = L::both(inside, L::ge(dist, L::neg(reach)));
+			}
+
+			count = appendVisible<L>(L::bits(inside), i, visible, count);
+		}
+
+		return count;
+	}
+
+	// Wraps the templates into the Kernels entry points: the wide lane does
+	// the bulk, the scalar lane picks up the tail.
+	template<class L>
+	struct KernelSet
+	{
+		static size_t bulk(size_t count) { return count - count % L::WIDTH; }
+
+		static void transformSpheres(const float m[16], float radiusScale, const float* const in[4], float* const out[4], size_t count) {
+			transformSpheresT<L>(m, radiusScale, in, out, 0, bulk(count));
+			transformSpheresT<ScalarLane>(m, radiusScale, in, out, bulk(count), count);
+		}
+
+		static void transformBoxes(const float m[16], const float* const in[6], float* const out[6], size_t count) {
+			transformBoxesT<L>(m, in, out, 0, bulk(count));
+			transformBoxesT<ScalarLane>(m, in, out, bulk(count), count);
+		}
+
+		static size_t cullSpheres(const Frustum& f, const float* const in[4], size_t count, uint32_t* visible) {
+			size_t n = cullSpheresT<L>(f, in, 0, bulk(count), visible, 0);
+			return cullSpheresT<ScalarLane>(f, in, bulk(count), count, visible, n);
+		}
+
+		static size_t cullBoxes(const Frustum& f, const float* const in[6], size_t count, uint32_t* visible) {
+			size_t n = cullBoxesT<L>(f, in, 0, bulk(count), visible, 0);
+			return cullBoxesT<ScalarLane>(f, in, bulk(count), count, visible, n);
+		}
+
+		static const culling::detail::Kernels* get() {
+			static const culling::detail::Kernels kernels = {
+				&transformSpheres,
+				&transformBoxes,
+				&cullSpheres,
+				&cullBoxes
+			};
+			return &kernels;
+		}
+	};
+
+}
@@ -0,0 +1,46 @@
+#include "CullingKernels.inl"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+
+#include <arm_neon.h>
+
+namespace {
+
+	struct NEONLane
+	{
+		typedef float32x4_t F;
+		typedef uint32x4_t M;
+		static const size_t WIDTH = 4;
+
+		static F load(const float* p) { return vld1q_f32(p); }
+		static void store(float* p, F v) { vst1q_f32(p, v); }
+		static F splat(float v) { return vdupq_n_f32(v); }
+		static F add(F a, F b) { return vaddq_f32(a, b); }
+		static F mul(F a, F b) { return vmulq_f32(a, b); }
+		static F madd(F a, F b, F c) { return vmlaq_f32(c, a, b); }
+		static F neg(F a) { return vnegq_f32(a); }
+		static F abs(F a) { return vabsq_f32(a); }
+		static M ge(F a, F b) { return vcgeq_f32(a, b); }
+		static M both(M a, M b) { return vandq_u32(a, b); }
+		static M all() { return vdupq_n_u32(0xFFFFFFFFu); }
+		static unsigned bits(M m) {
+			uint32x4_t b = vshrq_n_u32(m, 31);
+			return vgetq_lane_u32(b, 0) | (vgetq_lane_u32(b, 1) << 1) | (vgetq_lane_u32(b, 2) << 2) | (vgetq_lane_u32(b, 3) << 3);
+		}
+	};
+
+}
+
+const culling::detail::Kernels* culling::detail::getNEONKernels()
+{
+	return KernelSet<NEONLane>::get();
+}
+
+#else
+
+const culling::detail::Kernels* culling::detail::getNEONKernels()
+{
+	return nullptr;
+}
+
+#endif
@@ -0,0 +1,43 @@
+#include "CullingKernels.inl"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+
+#include <emmintrin.h>
+
+namespace {
+
+	struct SSELane
+	{
+		typedef __m128 F;
+		typedef __m128 M;
+		static const size_t WIDTH = 4;
+
+		static F load(const float* p) { return _mm_loadu_ps(p); }
+		static void store(float* p, F v) { _mm_storeu_ps(p, v); }
+		static F splat(float v) { return _mm_set1_ps(v); }
+		static F add(F a, F b) { return _mm_add_ps(a, b); }
+		static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+		static F madd(F a, F b, F c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		static F neg(F a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+		static F abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+		static M ge(F a, F b) { return _mm_cmpge_ps(a, b); }
+		static M both(M a, M b) { return _mm_and_ps(a, b); }
+		static M all() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+		static unsigned bits(M m) { return static_cast<unsigned>(_mm_movemask_ps(m)); }
+	};
+
+}
+
+const culling::detail::Kernels* culling::detail::getSSEKernels()
+{
+	return KernelSet<SSELane>::get();
+}
+
+#else
+
+const culling::detail::Kernels* culling::detail::getSSEKernels()
+{
+	return nullptr;
+}
+
+#endif
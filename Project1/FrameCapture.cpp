@@ -0,0 +1,367 @@
+#include "FrameCapture.h"
+
+#include <limits>
+
+FrameCapture::FrameCapture() : captured(0)
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+	destroy();
+}
+
+void FrameCapture::create(VkDevice dev, MemoryBudget* b)
+{
+	device = dev;
+	budget = b;
+}
+
+void FrameCapture::destroy()
+{
+	if (device == VK_NULL_HANDLE) return;
+
+	// Teardown has nowhere to report a failed write to; call stop() first
+	// to see it.
+	try {
+		stop();
+	}
+	catch (...) {
+	}
+	device = VK_NULL_HANDLE;
+}
+
+// Reading uncached memory from the CPU is very slow, so cached memory is
+// preferred even though it then has to be invalidated before each read.
+bool findReadbackMemoryType(const VkPhysicalDeviceMemoryProperties& properties, uint32_t typeFilter, uint32_t& typeIndex, bool& coherent) {
+	const VkMemoryPropertyFlags preferred[] = {
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	};
+
+	for (VkMemoryPropertyFlags flags : preferred) {
+		for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (properties.memoryTypes[i].propertyFlags & flags) == flags) {
+				typeIndex = i;
+				coherent = (properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void FrameCapture::start(FrameSink* s, VkExtent2D ext, VkFormat fmt)
+{
+	if (sink) stop();
+
+	switch (fmt) {
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		break;
+	default:
+		ERROR("Frame capture only supports 8 bit RGBA and BGRA images!");
+	}
+
+	extent = ext;
+	format = fmt;
+	frameSize = VkDeviceSize(extent.width) * extent.height * 4;
+
+	for (Slot& slot : slots) {
+		slot.owner = this;
+		allocateBuffer(slot);
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkCreateFence(device, &fenceInfo, nullptr, &slot.fence) != VK_SUCCESS) {
+			ERROR("Failed to create capture fence!");
+		}
+
+		setState(slot, SlotState::FREE);
+		budget->registerStreamable(&slot);
+	}
+
+	nextSlot = 0;
+	oldestSlot = 0;
+	recordedSlot = -1;
+	sink = s;
+
+	stopping = false;
+	writeError = nullptr;
+	writer = std::thread(&FrameCapture::writerLoop, this);
+}
+
+void FrameCapture::allocateBuffer(Slot& slot)
+{
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = frameSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &slot.buffer) != VK_SUCCESS) {
+		ERROR("Failed to create capture buffer!");
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, slot.buffer, &requirements);
+
+	uint32_t memoryTypeIndex;
+	if (!findReadbackMemoryType(budget->getMemoryProperties(), requirements.memoryTypeBits, memoryTypeIndex, coherent)) {
+		ERROR("Failed to find host visible memory for frame capture!");
+	}
+
+	slot.memory = budget->allocate(requirements.size, memoryTypeIndex, MemoryCategory::STAGING);
+	slot.memorySize = requirements.size;
+	slot.heapIndex = budget->getMemoryProperties().memoryTypes[memoryTypeIndex].heapIndex;
+
+	vkBindBufferMemory(device, slot.buffer, slot.memory, 0);
+
+	// Mapped for the lifetime of the buffer; sinks read straight from it.
+	void* data;
+	if (vkMapMemory(device, slot.memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+		ERROR("Failed to map capture buffer memory!");
+	}
+	slot.mapped = static_cast<const uint8_t*>(data);
+}
+
+void FrameCapture::freeBuffer(Slot& slot)
+{
+	vkDestroyBuffer(device, slot.buffer, nullptr);
+	budget->free(slot.memory);
+
+	slot.buffer = VK_NULL_HANDLE;
+	slot.memory = VK_NULL_HANDLE;
+	slot.mapped = nullptr;
+}
+
+VkDeviceSize FrameCapture::releaseBuffer(Slot& slot)
+{
+	// Only the render thread moves a slot out of FREE, and that's the thread
+	// the budget reduces from.
+	if (slot.memory == VK_NULL_HANDLE || getState(slot) != SlotState::FREE) return 0;
+
+	freeBuffer(slot);
+	return slot.memorySize;
+}
+
+void FrameCapture::stop()
+{
+	if (!sink) return;
+
+	// Drain in order, blocking this time.
+	for (uint32_t i = 0; i < BUFFER_COUNT; i++) {
+		Slot& slot = slots[oldestSlot];
+		if (getState(slot) == SlotState::IN_FLIGHT) {
+			vkWaitForFences(device, 1, &slot.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+			deliver(slot);
+		}
+		oldestSlot = (oldestSlot + 1) % BUFFER_COUNT;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	queueChanged.notify_one();
+	writer.join();
+
+	for (Slot& slot : slots) {
+		budget->unregisterStreamable(&slot);
+		vkDestroyFence(device, slot.fence, nullptr);
+		freeBuffer(slot);
+		slot = Slot();
+	}
+
+	sink = nullptr;
+
+	if (writeError) {
+		std::exception_ptr error = writeError;
+		writeError = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+FrameCapture::SlotState FrameCapture::getState(const Slot& slot)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return slot.state;
+}
+
+void FrameCapture::setState(Slot& slot, SlotState state)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	slot.state = state;
+}
+
+void FrameCapture::deliver(Slot& slot)
+{
+	if (!coherent) {
+		VkMappedMemoryRange range = {};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = slot.memory;
+		range.offset = 0;
+		range.size = VK_WHOLE_SIZE;
+		vkInvalidateMappedMemoryRanges(device, 1, &range);
+	}
+
+	vkResetFences(device, 1, &slot.fence);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		slot.state = SlotState::WRITING;
+		queue.push_back(static_cast<uint32_t>(&slot - slots));
+	}
+	queueChanged.notify_one();
+}
+
+void FrameCapture::writerLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for (;;) {
+		queueChanged.wait(lock, [this] { return !queue.empty() || stopping; });
+		if (queue.empty()) return;
+
+		Slot& slot = slots[queue.front()];
+		bool failed = writeError != nullptr;
+
+		// The slot belongs to this thread until it's marked free, so the
+		// sink can take its time without holding up the render thread.
+		lock.unlock();
+
+		std::exception_ptr error;
+		if (!failed) {
+			CapturedFrame frame;
+			frame.pixels = slot.mapped;
+			frame.width = extent.width;
+			frame.height = extent.height;
+			frame.rowPitch = extent.width * 4;
+			frame.format = format;
+			frame.index = slot.frameIndex;
+
+			try {
+				sink->writeFrame(frame);
+				captured++;
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+		}
+
+		lock.lock();
+		if (error) writeError = error;
+		queue.pop_front();
+		slot.state = SlotState::FREE;
+	}
+}
+
+void FrameCapture::poll()
+{
+	if (!sink) return;
+
+	bool failed;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		failed = writeError != nullptr;
+	}
+	if (failed) {
+		stop();
+	}
+
+	while (getState(slots[oldestSlot]) == SlotState::IN_FLIGHT && vkGetFenceStatus(device, slots[oldestSlot].fence) == VK_SUCCESS) {
+		deliver(slots[oldestSlot]);
+		oldestSlot = (oldestSlot + 1) % BUFFER_COUNT;
+	}
+}
+
+bool FrameCapture::record(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout layout)
+{
+	if (!sink) return false;
+
+	uint64_t index = frameIndex++;
+
+	// Slots are freed in the order they were used, so if the next one is
+	// still busy, all of them are.
+	Slot& slot = slots[nextSlot];
+	if (getState(slot) != SlotState::FREE) {
+		dropped++;
+		return false;
+	}
+
+	if (slot.buffer == VK_NULL_HANDLE) {
+		allocateBuffer(slot);
+	}
+	budget->touch(&slot);
+
+	VkImageMemoryBarrier imageBarrier = {};
+	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	imageBarrier.oldLayout = layout;
+	imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image = image;
+	imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageBarrier.subresourceRange.levelCount = 1;
+	imageBarrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = { extent.width, extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+	// Make the copy visible to the host reads in deliver().
+	VkBufferMemoryBarrier bufferBarrier = {};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = slot.buffer;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+
+	// Put the image back where the caller expects it, e.g. for presenting.
+	imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	imageBarrier.dstAccessMask = 0;
+	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarrier.newLayout = layout;
+
+	uint32_t imageBarrierCount = layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ? 0 : 1;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr, 1, &bufferBarrier, imageBarrierCount, &imageBarrier);
+
+	slot.frameIndex = index;
+	setState(slot, SlotState::RECORDED);
+	recordedSlot = static_cast<int>(nextSlot);
+	nextSlot = (nextSlot + 1) % BUFFER_COUNT;
+
+	return true;
+}
+
+void FrameCapture::submitted(VkQueue queue)
+{
+	if (recordedSlot < 0) return;
+
+	Slot& slot = slots[recordedSlot];
+	recordedSlot = -1;
+
+	// An empty submission's fence signals once everything submitted before
+	// it, including the copy, has completed.
+	if (vkQueueSubmit(queue, 0, nullptr, slot.fence) != VK_SUCCESS) {
+		ERROR("Failed to submit capture fence!");
+	}
+
+	setState(slot, SlotState::IN_FLIGHT);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "libs.h"
+#include "FrameSink.h"
+#include "MemoryBudget.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+// Continuous readback of the final render target without stalling the frame
+// loop. Each captured frame is copied at the end of its command buffer into
+// one of a few persistently mapped host buffers, and the fence submitted
+// behind it is polled at the start of later frames. Finished buffers are
+// handed in place to a writer thread, which runs the sink and frees the
+// buffer when it returns. If every buffer is still in flight or being
+// written, the frame is dropped instead of waited for.
+//
+// Each buffer is a streamable resource, so under memory pressure the budget
+// can take back idle ones; they're recreated when their turn comes again.
+class FrameCapture
+{
+public:
+	static const uint32_t BUFFER_COUNT = 3;
+
+	FrameCapture();
+	~FrameCapture();
+
+	// Readback memory is allocated through `budget`, which must outlive this.
+	void create(VkDevice device, MemoryBudget* budget);
+	void destroy();
+
+	// Allocates the readback buffers for images of `extent` and `format`.
+	// The sink isn't owned and must outlive stop().
+	void start(FrameSink* sink, VkExtent2D extent, VkFormat format);
+	// Waits for frames still in flight and for the sink to write them, then
+	// frees the buffers. Rethrows the first error the sink threw, if any.
+	void stop();
+
+	bool isActive() { return sink != nullptr; }
+
+	// Hands every finished frame to the writer, in order, without blocking.
+	// Stops capture and rethrows if the sink has failed.
+	void poll();
+
+	// Records the copy of `image` (in `layout`, which it's left in) after it
+	// was written by rendering or a transfer. Returns false when the frame
+	// had to be dropped.
+	bool record(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout layout);
+	// Call right after the queue submission containing record().
+	void submitted(VkQueue queue);
+
+	uint64_t getCapturedCount() { return captured; }
+	uint64_t getDroppedCount() { return dropped; }
+
+private:
+
+	enum class SlotState {
+		FREE,
+		RECORDED,
+		IN_FLIGHT,
+		WRITING
+	};
+
+	struct Slot : public StreamableResource {
+		FrameCapture* owner = nullptr;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize memorySize = 0;
+		uint32_t heapIndex = 0;
+		VkFence fence = VK_NULL_HANDLE;
+		const uint8_t* mapped = nullptr;
+
+		SlotState state = SlotState::FREE;
+		uint64_t frameIndex = 0;
+
+		uint32_t getHeapIndex() override { return heapIndex; }
+		VkDeviceSize getResidentSize() override { return memory != VK_NULL_HANDLE ? memorySize : 0; }
+		VkDeviceSize reduce(VkDeviceSize) override { return owner->releaseBuffer(*this); }
+	};
+
+	void allocateBuffer(Slot& slot);
+	void freeBuffer(Slot& slot);
+	// Frees the buffer of a slot that's not in use, returning the bytes freed.
+	VkDeviceSize releaseBuffer(Slot& slot);
+
+	SlotState getState(const Slot& slot);
+	void setState(Slot& slot, SlotState state);
+	// Only called on the render thread.
+	void deliver(Slot& slot);
+	void writerLoop();
+
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryBudget* budget = nullptr;
+
+	FrameSink* sink = nullptr;
+	VkExtent2D extent;
+	VkFormat format;
+	VkDeviceSize frameSize = 0;
+	bool coherent = false;
+
+	Slot slots[BUFFER_COUNT];
+	// Slots are used round robin, so frames complete in this order too.
+	uint32_t nextSlot = 0;
+	uint32_t oldestSlot = 0;
+	int recordedSlot = -1;
+
+	uint64_t frameIndex = 0;
+	std::atomic<uint64_t> captured;
+	uint64_t dropped = 0;
+
+	// Guards the slot states and the writer's queue and error.
+	std::mutex mutex;
+	std::condition_variable queueChanged;
+	// Slots in WRITING, oldest first.
+	std::deque<uint32_t> queue;
+	bool stopping = false;
+	std::exception_ptr writeError;
+	std::thread writer;
+
+};
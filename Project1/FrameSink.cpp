@@ -0,0 +1,109 @@
+#include "FrameSink.h"
+
+#include <string>
+
+// Windows pipes are text mode unless asked otherwise; POSIX only accepts "w".
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define PIPE_MODE "wb"
+#else
+#define PIPE_MODE "w"
+#endif
+
+FileSink::FileSink(const std::string& path, bool p)
+{
+	pipe = p;
+	file = pipe ? popen(path.c_str(), PIPE_MODE) : fopen(path.c_str(), "wb");
+
+	if (!file) {
+		ERROR("Failed to open '" + path + "' for frame capture!");
+	}
+}
+
+FileSink::~FileSink()
+{
+	if (pipe) {
+		pclose(file);
+	}
+	else {
+		fclose(file);
+	}
+}
+
+void FileSink::write(const void* data, size_t size)
+{
+	if (fwrite(data, 1, size, file) != size) {
+		ERROR("Failed to write captured frame!");
+	}
+}
+
+void RawVideoSink::writeFrame(const CapturedFrame& frame)
+{
+	size_t rowSize = size_t(frame.width) * 4;
+
+	if (frame.rowPitch == rowSize) {
+		write(frame.pixels, rowSize * frame.height);
+		return;
+	}
+
+	for (uint32_t y = 0; y < frame.height; y++) {
+		write(frame.pixels + size_t(y) * frame.rowPitch, rowSize);
+	}
+}
+
+Y4MSink::Y4MSink(const std::string& path, bool pipe, uint32_t f) : FileSink(path, pipe)
+{
+	fps = f;
+}
+
+bool isBGRA(VkFormat format) {
+	return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+void Y4MSink::writeFrame(const CapturedFrame& frame)
+{
+	if (!wroteHeader) {
+		width = frame.width;
+		height = frame.height;
+
+		std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height)
+			+ " F" + std::to_string(fps) + ":1 Ip A1:1 C444\n";
+		write(header.data(), header.size());
+		wroteHeader = true;
+	}
+	else if (frame.width != width || frame.height != height) {
+		ERROR("Y4M streams can't change resolution!");
+	}
+
+	size_t planeSize = size_t(width) * height;
+	planes.resize(planeSize * 3);
+
+	uint8_t* yPlane = planes.data();
+	uint8_t* uPlane = yPlane + planeSize;
+	uint8_t* vPlane = uPlane + planeSize;
+
+	int r = isBGRA(frame.format) ? 2 : 0;
+	int b = 2 - r;
+
+	// BT.601 limited range in 8.8 fixed point, which is what Y4M readers
+	// assume when the header doesn't say otherwise.
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t* row = frame.pixels + size_t(y) * frame.rowPitch;
+		size_t out = size_t(y) * width;
+
+		for (uint32_t x = 0; x < width; x++) {
+			int R = row[x * 4 + r];
+			int G = row[x * 4 + 1];
+			int B = row[x * 4 + b];
+
+			yPlane[out + x] = static_cast<uint8_t>(((66 * R + 129 * G + 25 * B + 128) >> 8) + 16);
+			uPlane[out + x] = static_cast<uint8_t>(((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128);
+			vPlane[out + x] = static_cast<uint8_t>(((112 * R - 94 * G - 18 * B + 128) >> 8) + 128);
+		}
+	}
+
+	static const char frameHeader[] = "FRAME\n";
+	write(frameHeader, sizeof(frameHeader) - 1);
+	write(planes.data(), planes.size());
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "libs.h"
+
+#include <cstdio>
+#include <vector>
+
+// One captured frame, as handed to a FrameSink. `pixels` points straight into
+// the mapped readback buffer and is only valid during writeFrame().
+struct CapturedFrame
+{
+	const uint8_t* pixels;
+	uint32_t width;
+	uint32_t height;
+	uint32_t rowPitch;
+	// VK_FORMAT_R8G8B8A8_* or VK_FORMAT_B8G8R8A8_*.
+	VkFormat format;
+
+	// Counts every frame capture was asked for, so gaps show dropped frames.
+	uint64_t index;
+};
+
+// Receives frames from FrameCapture on its writer thread, in order. A slow
+// sink doesn't stall rendering: frames are dropped while all readback
+// buffers are in flight or being written. Errors thrown here stop capture
+// and are rethrown on the render thread.
+class FrameSink
+{
+public:
+	virtual ~FrameSink() {}
+
+	virtual void writeFrame(const CapturedFrame& frame) = 0;
+};
+
+// Writes to a file, or with `pipe` set, to the standard input of the shell
+// command `path` (e.g. an ffmpeg invocation).
+class FileSink : public FrameSink
+{
+public:
+	FileSink(const std::string& path, bool pipe = false);
+	~FileSink();
+
+protected:
+	void write(const void* data, size_t size);
+
+private:
+	FILE* file = nullptr;
+	bool pipe;
+};
+
+// The pixels exactly as read back, one frame after another. Suits
+// `ffmpeg -f rawvideo -pix_fmt rgba -s WxH -i -` (bgra for swap chains).
+class RawVideoSink : public FileSink
+{
+public:
+	RawVideoSink(const std::string& path, bool pipe = false) : FileSink(path, pipe) {}
+
+	void writeFrame(const CapturedFrame& frame) override;
+};
+
+// YUV4MPEG2 with 4:4:4 planes, which most players and encoders read directly.
+// The stream has a fixed rate, so dropped frames shorten the recording.
+class Y4MSink : public FileSink
+{
+public:
+	Y4MSink(const std::string& path, bool pipe = false, uint32_t fps = 60);
+
+	void writeFrame(const CapturedFrame& frame) override;
+
+private:
+	uint32_t fps;
+	bool wroteHeader = false;
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	// Reused Y, U and V planes.
+	std::vector<uint8_t> planes;
+};
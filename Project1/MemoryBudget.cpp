@@ -0,0 +1,303 @@
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <iostream>
+
+// Share of a heap we allow ourselves without VK_EXT_memory_budget. Host
+// visible heaps are usually system memory shared with everything else.
+const double deviceLocalHeapShare = 0.8;
+const double hostHeapShare = 0.5;
+
+const double highWatermark = 0.95;
+const double lowWatermark = 0.85;
+
+const uint32_t categoryCount = static_cast<uint32_t>(MemoryCategory::COUNT);
+
+const char* getCategoryName(MemoryCategory category) {
+	switch (category) {
+	case MemoryCategory::TEXTURES: return "textures";
+	case MemoryCategory::GEOMETRY: return "geometry";
+	case MemoryCategory::RENDER_TARGETS: return "render targets";
+	case MemoryCategory::STAGING: return "staging";
+	default: return "unknown";
+	}
+}
+
+// With VK_EXT_memory_priority, what the driver should keep resident longest
+// when it has to page. Render targets are touched every frame and can't be
+// streamed back in, while staging memory is cheap to lose.
+float getCategoryPriority(MemoryCategory category) {
+	switch (category) {
+	case MemoryCategory::RENDER_TARGETS: return 1.0f;
+	case MemoryCategory::GEOMETRY: return 0.75f;
+	case MemoryCategory::TEXTURES: return 0.5f;
+	case MemoryCategory::STAGING: return 0.25f;
+	default: return 0.5f;
+	}
+}
+
+MemoryBudget::MemoryBudget()
+{
+}
+
+MemoryBudget::~MemoryBudget()
+{
+	destroy();
+}
+
+void MemoryBudget::create(VkInstance inst, VkPhysicalDevice physical, VkDevice dev, const MemoryBudgetSupport& s)
+{
+	instance = inst;
+	physicalDevice = physical;
+	device = dev;
+	support = s;
+
+	if (support.budget) {
+		getMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+		support.budget = getMemoryProperties2 != nullptr;
+	}
+
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	for (uint32_t i = 0; i < categoryCount; i++) {
+		tracked[i].assign(memoryProperties.memoryHeapCount, 0);
+	}
+	driverUsage.assign(memoryProperties.memoryHeapCount, 0);
+	driverBudget.assign(memoryProperties.memoryHeapCount, 0);
+	trackedAtRefresh.assign(memoryProperties.memoryHeapCount, 0);
+
+	refresh();
+}
+
+void MemoryBudget::destroy()
+{
+	if (device == VK_NULL_HANDLE) return;
+
+	// Whatever is left belongs to someone who forgot to free it.
+	if (!allocations.empty()) {
+		uint32_t counts[categoryCount] = {};
+		VkDeviceSize bytes[categoryCount] = {};
+		for (auto& allocation : allocations) {
+			uint32_t category = static_cast<uint32_t>(allocation.second.category);
+			counts[category]++;
+			bytes[category] += allocation.second.size;
+		}
+
+		for (uint32_t i = 0; i < categoryCount; i++) {
+			if (counts[i] == 0) continue;
+			std::cerr << "[MemoryBudget]: " << counts[i] << " " << getCategoryName(static_cast<MemoryCategory>(i))
+				<< " allocations (" << bytes[i] << " bytes) were never freed" << std::endl;
+		}
+	}
+
+	for (auto& allocation : allocations) {
+		vkFreeMemory(device, allocation.first, nullptr);
+	}
+	allocations.clear();
+
+	lru.clear();
+	lruEntries.clear();
+	device = VK_NULL_HANDLE;
+}
+
+void MemoryBudget::refresh()
+{
+	for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+		trackedAtRefresh[heap] = 0;
+		for (uint32_t i = 0; i < categoryCount; i++) {
+			trackedAtRefresh[heap] += tracked[i][heap];
+		}
+	}
+
+#ifdef VK_EXT_memory_budget
+	if (support.budget) {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2KHR properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+		properties.pNext = &budgetProperties;
+		getMemoryProperties2(physicalDevice, &properties);
+
+		for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+			driverUsage[heap] = budgetProperties.heapUsage[heap];
+			driverBudget[heap] = budgetProperties.heapBudget[heap];
+		}
+		return;
+	}
+#endif
+
+	for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+		const VkMemoryHeap& info = memoryProperties.memoryHeaps[heap];
+		double share = (info.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? deviceLocalHeapShare : hostHeapShare;
+
+		driverUsage[heap] = trackedAtRefresh[heap];
+		driverBudget[heap] = static_cast<VkDeviceSize>(info.size * share);
+	}
+}
+
+VkDeviceSize MemoryBudget::getUsage(uint32_t heapIndex)
+{
+	VkDeviceSize now = 0;
+	for (uint32_t i = 0; i < categoryCount; i++) {
+		now += tracked[i][heapIndex];
+	}
+
+	// Driver usage at the last refresh, plus or minus what we've done since.
+	VkDeviceSize before = trackedAtRefresh[heapIndex];
+	if (now >= before) {
+		return driverUsage[heapIndex] + (now - before);
+	}
+	return driverUsage[heapIndex] - std::min(driverUsage[heapIndex], before - now);
+}
+
+MemoryBudget::Heap MemoryBudget::getHeap(uint32_t heapIndex)
+{
+	Heap heap;
+	heap.size = memoryProperties.memoryHeaps[heapIndex].size;
+	heap.budget = driverBudget[heapIndex];
+	heap.usage = getUsage(heapIndex);
+	heap.deviceLocal = (memoryProperties.memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	return heap;
+}
+
+VkDeviceSize MemoryBudget::getCategoryUsage(MemoryCategory category)
+{
+	VkDeviceSize total = 0;
+	for (VkDeviceSize bytes : tracked[static_cast<uint32_t>(category)]) {
+		total += bytes;
+	}
+	return total;
+}
+
+VkDeviceSize MemoryBudget::getCategoryUsage(MemoryCategory category, uint32_t heapIndex)
+{
+	return tracked[static_cast<uint32_t>(category)][heapIndex];
+}
+
+VkDeviceMemory MemoryBudget::allocate(VkDeviceSize size, uint32_t memoryTypeIndex, MemoryCategory category)
+{
+	uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+
+	VkDeviceSize usage = getUsage(heapIndex);
+	if (usage + size > driverBudget[heapIndex]) {
+		reduceHeap(heapIndex, usage + size - driverBudget[heapIndex]);
+	}
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+#ifdef VK_EXT_memory_priority
+	VkMemoryPriorityAllocateInfoEXT priorityInfo = {};
+	priorityInfo.sType = VK_STRUCTURE_TYPE_MEMORY_PRIORITY_ALLOCATE_INFO_EXT;
+	priorityInfo.priority = getCategoryPriority(category);
+
+	if (support.priority) {
+		allocInfo.pNext = &priorityInfo;
+	}
+#endif
+
+	VkDeviceMemory memory;
+	VkResult result = vkAllocateMemory(device, &allocInfo, nullptr, &memory);
+
+	// The budget is only an estimate; if the driver disagrees, free what we
+	// can and try once more.
+	if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) {
+		if (reduceHeap(heapIndex, size) > 0) {
+			result = vkAllocateMemory(device, &allocInfo, nullptr, &memory);
+		}
+	}
+
+	if (result != VK_SUCCESS) {
+		ERROR(std::string("Failed to allocate device memory for ") + getCategoryName(category) + "!");
+	}
+
+	allocations[memory] = { size, heapIndex, category };
+	tracked[static_cast<uint32_t>(category)][heapIndex] += size;
+	allocationCount++;
+
+	return memory;
+}
+
+void MemoryBudget::free(VkDeviceMemory memory)
+{
+	if (memory == VK_NULL_HANDLE) return;
+
+	auto found = allocations.find(memory);
+	if (found != allocations.end()) {
+		tracked[static_cast<uint32_t>(found->second.category)][found->second.heapIndex] -= found->second.size;
+		allocations.erase(found);
+	}
+
+	vkFreeMemory(device, memory, nullptr);
+}
+
+void MemoryBudget::registerStreamable(StreamableResource* resource)
+{
+	if (lruEntries.count(resource)) return;
+
+	// Assume it's about to be used, since it was presumably just uploaded.
+	lruEntries[resource] = lru.insert(lru.end(), { resource, currentFrame });
+}
+
+void MemoryBudget::unregisterStreamable(StreamableResource* resource)
+{
+	auto found = lruEntries.find(resource);
+	if (found == lruEntries.end()) return;
+
+	lru.erase(found->second);
+	lruEntries.erase(found);
+}
+
+void MemoryBudget::touch(StreamableResource* resource)
+{
+	auto found = lruEntries.find(resource);
+	if (found == lruEntries.end()) return;
+
+	found->second->lastUsedFrame = currentFrame;
+	lru.splice(lru.end(), lru, found->second);
+}
+
+VkDeviceSize MemoryBudget::reduceHeap(uint32_t heapIndex, VkDeviceSize bytes)
+{
+	// reduce() may unregister resources, so pick the candidates up front.
+	// The list is in use order, so everything after the first resource a
+	// frame in flight still uses is in use as well.
+	std::vector<StreamableResource*> candidates;
+	for (const LRUEntry& entry : lru) {
+		if (entry.lastUsedFrame >= oldestFrameInFlight) break;
+		if (entry.resource->getHeapIndex() == heapIndex && entry.resource->getResidentSize() > 0) {
+			candidates.push_back(entry.resource);
+		}
+	}
+
+	VkDeviceSize freed = 0;
+	for (StreamableResource* resource : candidates) {
+		if (freed >= bytes) break;
+		if (!lruEntries.count(resource)) continue;
+
+		freed += resource->reduce(bytes - freed);
+	}
+
+	return freed;
+}
+
+void MemoryBudget::update(uint64_t frame, uint64_t oldestInFlight)
+{
+	currentFrame = frame;
+	oldestFrameInFlight = oldestInFlight;
+
+	refresh();
+
+	for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+		VkDeviceSize usage = getUsage(heap);
+		VkDeviceSize budget = driverBudget[heap];
+
+		if (usage > budget * highWatermark) {
+			VkDeviceSize target = static_cast<VkDeviceSize>(budget * lowWatermark);
+			reduceHeap(heap, usage - target);
+		}
+	}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "libs.h"
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// What the physical device offers for memory budgeting. Filled in by
+// pickDevice() and consumed by createLogicalDevice() and MemoryBudget.
+struct MemoryBudgetSupport
+{
+	// VK_EXT_memory_budget: real per heap usage and budget from the driver.
+	bool budget = false;
+	// VK_EXT_memory_priority: hints for what to keep resident under pressure.
+	bool priority = false;
+};
+
+enum class MemoryCategory : uint32_t {
+	TEXTURES,
+	GEOMETRY,
+	RENDER_TARGETS,
+	STAGING,
+	COUNT
+};
+
+const char* getCategoryName(MemoryCategory category);
+
+// Something whose memory can be given back under pressure and brought back
+// later, such as a texture that can drop its top mip levels or a mesh far
+// from the camera. MemoryBudget only calls reduce() once the GPU is done
+// with every frame that used the resource.
+class StreamableResource
+{
+public:
+	virtual ~StreamableResource() {}
+
+	virtual uint32_t getHeapIndex() = 0;
+	virtual VkDeviceSize getResidentSize() = 0;
+
+	// Frees roughly `bytes` (or more) by downgrading or evicting entirely,
+	// releasing the memory through MemoryBudget::free(). Returns how much was
+	// freed, 0 once there's nothing left to give.
+	virtual VkDeviceSize reduce(VkDeviceSize bytes) = 0;
+};
+
+// Tracks device memory per heap and per category against a budget, and keeps
+// the engine under it by reducing streamable resources, least recently used
+// first. All device memory should be allocated through here.
+//
+// With VK_EXT_memory_budget the budget and usage come from the driver, which
+// accounts for other processes too. Otherwise the budget is a fixed share of
+// each heap and only this engine's allocations count as usage.
+class MemoryBudget
+{
+public:
+	struct Heap
+	{
+		VkDeviceSize size;
+		VkDeviceSize budget;
+		VkDeviceSize usage;
+		bool deviceLocal;
+	};
+
+	MemoryBudget();
+	~MemoryBudget();
+
+	void create(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, const MemoryBudgetSupport& support);
+	void destroy();
+
+	// Counts against the heap of `memoryTypeIndex`. Makes room first when the
+	// allocation would go over budget, and once more if the driver still
+	// runs out of memory.
+	VkDeviceMemory allocate(VkDeviceSize size, uint32_t memoryTypeIndex, MemoryCategory category);
+	void free(VkDeviceMemory memory);
+
+	void registerStreamable(StreamableResource* resource);
+	void unregisterStreamable(StreamableResource* resource);
+	// Marks the resource as used by the frame being recorded.
+	void touch(StreamableResource* resource);
+
+	// Call once per frame after waiting for a frame in flight, with the
+	// number of the frame about to be recorded and of the oldest frame that
+	// may still be running on the GPU. Refreshes the budget, and on heaps
+	// above 95% of it reduces streamable resources until usage is at 85%.
+	void update(uint64_t frame, uint64_t oldestFrameInFlight);
+
+	const VkPhysicalDeviceMemoryProperties& getMemoryProperties() { return memoryProperties; }
+	uint32_t getHeapCount() { return memoryProperties.memoryHeapCount; }
+	Heap getHeap(uint32_t heapIndex);
+
+	VkDeviceSize getCategoryUsage(MemoryCategory category);
+	VkDeviceSize getCategoryUsage(MemoryCategory category, uint32_t heapIndex);
+	uint32_t getAllocationCount() { return allocationCount; }
+
+	bool hasDriverBudget() { return support.budget; }
+
+private:
+
+	struct Allocation {
+		VkDeviceSize size;
+		uint32_t heapIndex;
+		MemoryCategory category;
+	};
+
+	struct LRUEntry {
+		StreamableResource* resource;
+		uint64_t lastUsedFrame;
+	};
+
+	void refresh();
+	VkDeviceSize getUsage(uint32_t heapIndex);
+	// Reduces resources the GPU is done with on `heapIndex` until `bytes`
+	// have been freed or nothing is left. Returns the bytes freed.
+	VkDeviceSize reduceHeap(uint32_t heapIndex, VkDeviceSize bytes);
+
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryBudgetSupport support;
+	// Looked up once, refresh() runs every frame.
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+	VkPhysicalDeviceMemoryProperties memoryProperties = {};
+
+	std::unordered_map<VkDeviceMemory, Allocation> allocations;
+	uint32_t allocationCount = 0;
+
+	// Bytes this engine has allocated, per heap and category.
+	std::vector<VkDeviceSize> tracked[static_cast<uint32_t>(MemoryCategory::COUNT)];
+	// Driver numbers from the last refresh(), and what we had tracked then,
+	// so usage in between can be estimated without querying again.
+	std::vector<VkDeviceSize> driverUsage;
+	std::vector<VkDeviceSize> driverBudget;
+	std::vector<VkDeviceSize> trackedAtRefresh;
+
+	// Least recently used at the front.
+	std::list<LRUEntry> lru;
+	std::unordered_map<StreamableResource*, std::list<LRUEntry>::iterator> lruEntries;
+	uint64_t currentFrame = 0;
+	uint64_t oldestFrameInFlight = 0;
+
+};
@@ -0,0 +1,141 @@
+#include "MeshFile.h"
+
+#include "utils.h"
+
+#include <cstddef>
+#include <fstream>
+
+const uint64_t sectionAlignment = 16;
+
+uint64_t alignSection(uint64_t offset) {
+	return (offset + sectionAlignment - 1) & ~(sectionAlignment - 1);
+}
+
+void writeSection(std::ofstream& file, uint64_t offset, const void* data, size_t size) {
+	static const char padding[sectionAlignment] = {};
+
+	uint64_t position = static_cast<uint64_t>(file.tellp());
+	file.write(padding, static_cast<std::streamsize>(offset - position));
+	file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+}
+
+void mesh::writeMeshFile(const std::string& filen, const PackedMesh& mesh)
+{
+	const void* indexData = mesh.indices16.empty() ? static_cast<const void*>(mesh.indices32.data()) : static_cast<const void*>(mesh.indices16.data());
+
+	FileHeader header = {};
+	header.magic = fileMagic;
+	header.version = fileVersion;
+	header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	header.indexCount = static_cast<uint32_t>(mesh.indexCount());
+	header.indexSize = mesh.indices16.empty() ? 4 : 2;
+	header.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+	header.meshletVertexCount = static_cast<uint32_t>(mesh.meshletVertices.size());
+	header.meshletTriangleBytes = static_cast<uint32_t>(mesh.meshletTriangles.size());
+
+	for (int i = 0; i < 3; i++) header.positionOffset[i] = mesh.positionOffset[i];
+	header.boundsRadius = mesh.boundsRadius;
+	for (int i = 0; i < 2; i++) {
+		header.uvOffset[i] = mesh.uvOffset[i];
+		header.uvScale[i] = mesh.uvScale[i];
+	}
+
+	header.vertexData = alignSection(sizeof(FileHeader));
+	header.indexData = alignSection(header.vertexData + header.vertexCount * sizeof(PackedVertex));
+	header.meshletData = alignSection(header.indexData + uint64_t(header.indexCount) * header.indexSize);
+	header.meshletVertexData = alignSection(header.meshletData + header.meshletCount * sizeof(Meshlet));
+	header.meshletTriangleData = alignSection(header.meshletVertexData + header.meshletVertexCount * sizeof(uint32_t));
+
+	std::ofstream file(filen, std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open()) {
+		ERROR("Failed to open file '" + filen + "' for writing!");
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	writeSection(file, header.vertexData, mesh.vertices.data(), mesh.vertices.size() * sizeof(PackedVertex));
+	writeSection(file, header.indexData, indexData, size_t(header.indexCount) * header.indexSize);
+	writeSection(file, header.meshletData, mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+	writeSection(file, header.meshletVertexData, mesh.meshletVertices.data(), mesh.meshletVertices.size() * sizeof(uint32_t));
+	writeSection(file, header.meshletTriangleData, mesh.meshletTriangles.data(), mesh.meshletTriangles.size());
+
+	if (!file) {
+		ERROR("Failed to write mesh file '" + filen + "'!");
+	}
+}
+
+// Sections have to be aligned, in file order and inside the file. Counts are
+// 32 bit, so count * stride can't overflow, but the offsets are untrusted.
+void checkSection(const std::string& filen, const char* name, uint64_t offset, uint64_t count, uint64_t stride, uint64_t fileSize, uint64_t& previousEnd) {
+	uint64_t size = count * stride;
+
+	if (offset % sectionAlignment != 0 || offset < previousEnd) {
+		ERROR("Mesh file '" + filen + "' has a misplaced " + name + " section!");
+	}
+	if (offset > fileSize || size > fileSize - offset) {
+		ERROR("Mesh file '" + filen + "' is truncated in its " + name + " section!");
+	}
+
+	previousEnd = offset + size;
+}
+
+mesh::MeshFile mesh::readMeshFile(const std::string& filen)
+{
+	MeshFile mesh;
+	mesh.data = utils::readFile(filen);
+
+	if (mesh.data.size() < sizeof(FileHeader)) {
+		ERROR("Mesh file '" + filen + "' is truncated!");
+	}
+
+	const FileHeader& header = mesh.header();
+	if (header.magic != fileMagic || header.version != fileVersion) {
+		ERROR("'" + filen + "' is not a version " + std::to_string(fileVersion) + " mesh file!");
+	}
+
+	if (header.indexSize != 2 && header.indexSize != 4) {
+		ERROR("Mesh file '" + filen + "' has an invalid index size!");
+	}
+
+	uint64_t fileSize = mesh.data.size();
+	uint64_t end = sizeof(FileHeader);
+	checkSection(filen, "vertex", header.vertexData, header.vertexCount, sizeof(PackedVertex), fileSize, end);
+	checkSection(filen, "index", header.indexData, header.indexCount, header.indexSize, fileSize, end);
+	checkSection(filen, "meshlet", header.meshletData, header.meshletCount, sizeof(Meshlet), fileSize, end);
+	checkSection(filen, "meshlet vertex", header.meshletVertexData, header.meshletVertexCount, sizeof(uint32_t), fileSize, end);
+	checkSection(filen, "meshlet triangle", header.meshletTriangleData, header.meshletTriangleBytes, 1, fileSize, end);
+
+	return mesh;
+}
+
+VkVertexInputBindingDescription mesh::getBindingDescription()
+{
+	VkVertexInputBindingDescription bindingDescription = {};
+	bindingDescription.binding = 0;
+	bindingDescription.stride = sizeof(PackedVertex);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 3> mesh::getAttributeDescriptions()
+{
+	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
+
+	attributeDescriptions[0].binding = 0;
+	attributeDescriptions[0].location = 0;
+	attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	attributeDescriptions[0].offset = offsetof(PackedVertex, position);
+
+	attributeDescriptions[1].binding = 0;
+	attributeDescriptions[1].location = 1;
+	attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+	attributeDescriptions[1].offset = offsetof(PackedVertex, normal);
+
+	attributeDescriptions[2].binding = 0;
+	attributeDescriptions[2].location = 2;
+	attributeDescriptions[2].format = VK_FORMAT_R16G16_UNORM;
+	attributeDescriptions[2].offset = offsetof(PackedVertex, uv);
+
+	return attributeDescriptions;
+}
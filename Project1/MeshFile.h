@@ -0,0 +1,66 @@
+#pragma once
+
+#include "libs.h"
+#include "MeshOptimizer.h"
+
+#include <array>
+#include <vector>
+
+// On-disk layout written by the MeshPacker tool. Everything after the header
+// is stored exactly as the GPU consumes it, each section 16 byte aligned,
+// so loading is one read and uploading is one memcpy per section.
+namespace mesh {
+
+	const uint32_t fileMagic = 0x4D4B5654; // "TVKM"
+	const uint32_t fileVersion = 1;
+
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t indexSize; // 2 or 4 bytes
+		uint32_t meshletCount;
+		uint32_t meshletVertexCount;
+		uint32_t meshletTriangleBytes;
+
+		float positionOffset[3];
+		float boundsRadius;
+		float uvOffset[2];
+		float uvScale[2];
+
+		// Byte offsets from the start of the file.
+		uint64_t vertexData;
+		uint64_t indexData;
+		uint64_t meshletData;
+		uint64_t meshletVertexData;
+		uint64_t meshletTriangleData;
+	};
+
+	// A loaded file: the raw bytes plus the header pointing into them.
+	struct MeshFile
+	{
+		std::vector<char> data;
+
+		const FileHeader& header() const { return *reinterpret_cast<const FileHeader*>(data.data()); }
+
+		const void* vertices() const { return data.data() + header().vertexData; }
+		VkDeviceSize vertexBytes() const { return VkDeviceSize(header().vertexCount) * sizeof(PackedVertex); }
+
+		const void* indices() const { return data.data() + header().indexData; }
+		VkDeviceSize indexBytes() const { return VkDeviceSize(header().indexCount) * header().indexSize; }
+		VkIndexType indexType() const { return header().indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32; }
+
+		const Meshlet* meshlets() const { return reinterpret_cast<const Meshlet*>(data.data() + header().meshletData); }
+	};
+
+	void writeMeshFile(const std::string& filen, const PackedMesh& mesh);
+	MeshFile readMeshFile(const std::string& filen);
+
+	// Vertex input state matching PackedVertex and shaders/mesh.vert.
+	VkVertexInputBindingDescription getBindingDescription();
+	std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
+
+}
@@ -0,0 +1,506 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+mesh::MeshStats mesh::analyze(const std::vector<uint32_t>& indices, size_t vertexCount, size_t vertexSize, size_t indexSize, uint32_t cacheSize)
+{
+	MeshStats stats = {};
+	stats.vertexCount = vertexCount;
+	stats.triangleCount = indices.size() / 3;
+	stats.vertexBytes = vertexCount * vertexSize;
+	stats.indexBytes = indices.size() * indexSize;
+
+	// Timestamp FIFO: a vertex is a hit while fewer than cacheSize misses
+	// have happened since it was last transformed.
+	std::vector<size_t> insertedAt(vertexCount, 0);
+	size_t misses = 0;
+
+	for (uint32_t index : indices) {
+		if (insertedAt[index] == 0 || misses - insertedAt[index] >= cacheSize) {
+			misses++;
+			insertedAt[index] = misses;
+		}
+	}
+
+	stats.vertexShaderInvocations = misses;
+	return stats;
+}
+
+// Vertex cache optimisation
+#if 1
+const float cacheDecayPower = 1.5f;
+const float lastTriScore = 0.75f;
+const float valenceBoostScale = 2.0f;
+const float valenceBoostPower = -0.5f;
+
+float scoreVertex(int cachePosition, uint32_t remainingTriangles, uint32_t cacheSize) {
+	if (remainingTriangles == 0) return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			// The triangle just emitted; it's used no matter which of its
+			// vertices comes next, so don't favour any of them.
+			score = lastTriScore;
+		}
+		else {
+			float scaler = 1.0f / (cacheSize - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scaler, cacheDecayPower);
+		}
+	}
+
+	// Favour vertices with few triangles left so they get finished off
+	// instead of lingering and needing a second transform later.
+	score += valenceBoostScale * std::pow((float)remainingTriangles, valenceBoostPower);
+
+	return score;
+}
+
+void mesh::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	const uint32_t cacheSize = defaultCacheSize;
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) return;
+
+	// Triangle adjacency, as offsets into one flat list per vertex.
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices) {
+		remaining[index]++;
+	}
+
+	std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+	}
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int k = 0; k < 3; k++) {
+			adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+		}
+	}
+
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		vertexScore[v] = scoreVertex(-1, remaining[v], cacheSize);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (size_t t = 0; t < triangleCount; t++) {
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> nextCache;
+	cache.reserve(cacheSize + 3);
+	nextCache.reserve(cacheSize + 3);
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	size_t scanCursor = 0;
+	size_t best = 0;
+	float bestScore = -1.0f;
+	for (size_t t = 0; t < triangleCount; t++) {
+		if (triangleScore[t] > bestScore) {
+			bestScore = triangleScore[t];
+			best = t;
+		}
+	}
+
+	while (true) {
+		emitted[best] = true;
+
+		uint32_t tri[3] = { indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2] };
+		result.insert(result.end(), tri, tri + 3);
+
+		// Take the triangle off its vertices' live lists.
+		for (uint32_t v : tri) {
+			uint32_t* begin = &adjacency[adjacencyOffset[v]];
+			uint32_t* end = begin + remaining[v];
+			*std::find(begin, end, static_cast<uint32_t>(best)) = *(end - 1);
+			remaining[v]--;
+		}
+
+		// LRU update: the new triangle's vertices go to the front.
+		nextCache.assign(tri, tri + 3);
+		for (uint32_t v : cache) {
+			if (v != tri[0] && v != tri[1] && v != tri[2]) {
+				nextCache.push_back(v);
+			}
+		}
+
+		for (size_t i = 0; i < nextCache.size(); i++) {
+			uint32_t v = nextCache[i];
+			cachePosition[v] = i < cacheSize ? static_cast<int>(i) : -1;
+			vertexScore[v] = scoreVertex(cachePosition[v], remaining[v], cacheSize);
+		}
+
+		if (nextCache.size() > cacheSize) {
+			nextCache.resize(cacheSize);
+		}
+		std::swap(cache, nextCache);
+
+		// Only triangles touching the cache changed score, so the next pick
+		// comes from them.
+		bestScore = -1.0f;
+		for (uint32_t v : cache) {
+			for (uint32_t i = 0; i < remaining[v]; i++) {
+				uint32_t t = adjacency[adjacencyOffset[v] + i];
+				float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				triangleScore[t] = score;
+
+				if (score > bestScore) {
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+
+		if (bestScore < 0.0f) {
+			// The cache has run dry; carry on with the next triangle in
+			// input order.
+			while (scanCursor < triangleCount && emitted[scanCursor]) {
+				scanCursor++;
+			}
+			if (scanCursor == triangleCount) break;
+			best = scanCursor;
+		}
+	}
+
+	indices.swap(result);
+}
+#endif
+
+void mesh::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	const uint32_t unused = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> remap(vertices.size(), unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices) {
+		if (remap[index] == unused) {
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+}
+
+// Quantization
+#if 1
+uint16_t mesh::floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t exponent = (bits >> 23) & 0xFF;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if (exponent == 0xFF) {
+		return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+	}
+
+	int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+	if (halfExponent >= 31) {
+		return static_cast<uint16_t>(sign | 0x7C00);
+	}
+
+	if (halfExponent <= 0) {
+		if (halfExponent < -10) return static_cast<uint16_t>(sign);
+
+		// Denormal: shift the mantissa, implicit bit included, into place.
+		mantissa |= 0x800000;
+		uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t midpoint = 1u << (shift - 1);
+		if (rest > midpoint || (rest == midpoint && (half & 1))) half++;
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	// Round to nearest even; a carry out of the mantissa correctly bumps the
+	// exponent, up to infinity.
+	uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1FFF;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+	return static_cast<uint16_t>(sign | half);
+}
+
+float mesh::halfToFloat(uint16_t value)
+{
+	uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+
+	uint32_t bits;
+	if (exponent == 0x1F) {
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else if (exponent != 0) {
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+	else if (mantissa == 0) {
+		bits = sign;
+	}
+	else {
+		// Denormal half, normal float.
+		exponent = 127 - 15 + 1;
+		while ((mantissa & 0x400) == 0) {
+			mantissa <<= 1;
+			exponent--;
+		}
+		bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+int16_t toSnorm16(float value) {
+	value = std::max(-1.0f, std::min(1.0f, value));
+	return static_cast<int16_t>(std::lround(value * 32767.0f));
+}
+
+uint16_t toUnorm16(float value) {
+	value = std::max(0.0f, std::min(1.0f, value));
+	return static_cast<uint16_t>(std::lround(value * 65535.0f));
+}
+
+// Projects the unit sphere onto an octahedron and unfolds it into a square.
+void encodeOctahedral(const float n[3], int16_t out[2]) {
+	float length = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+	if (length == 0.0f) {
+		out[0] = 0;
+		out[1] = 0;
+		return;
+	}
+
+	float x = n[0] / length;
+	float y = n[1] / length;
+
+	if (n[2] < 0.0f) {
+		float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+
+	out[0] = toSnorm16(x);
+	out[1] = toSnorm16(y);
+}
+
+mesh::PackedMesh mesh::quantize(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	PackedMesh packed;
+
+	float minPos[3] = { 0.0f, 0.0f, 0.0f }, maxPos[3] = { 0.0f, 0.0f, 0.0f };
+	float minUV[2] = { 0.0f, 0.0f }, maxUV[2] = { 0.0f, 0.0f };
+	if (!vertices.empty()) {
+		memcpy(minPos, vertices[0].position, sizeof(minPos));
+		memcpy(maxPos, vertices[0].position, sizeof(maxPos));
+		memcpy(minUV, vertices[0].uv, sizeof(minUV));
+		memcpy(maxUV, vertices[0].uv, sizeof(maxUV));
+	}
+
+	for (const Vertex& v : vertices) {
+		for (int i = 0; i < 3; i++) {
+			minPos[i] = std::min(minPos[i], v.position[i]);
+			maxPos[i] = std::max(maxPos[i], v.position[i]);
+		}
+		for (int i = 0; i < 2; i++) {
+			minUV[i] = std::min(minUV[i], v.uv[i]);
+			maxUV[i] = std::max(maxUV[i], v.uv[i]);
+		}
+	}
+
+	// Centering keeps the half floats in their most precise range.
+	float radiusSquared = 0.0f;
+	for (int i = 0; i < 3; i++) {
+		packed.positionOffset[i] = (minPos[i] + maxPos[i]) * 0.5f;
+		float half = (maxPos[i] - minPos[i]) * 0.5f;
+		radiusSquared += half * half;
+	}
+	packed.boundsRadius = std::sqrt(radiusSquared);
+
+	for (int i = 0; i < 2; i++) {
+		packed.uvOffset[i] = minUV[i];
+		packed.uvScale[i] = maxUV[i] > minUV[i] ? maxUV[i] - minUV[i] : 1.0f;
+	}
+
+	packed.vertices.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		const Vertex& v = vertices[i];
+		PackedVertex& p = packed.vertices[i];
+
+		for (int c = 0; c < 3; c++) {
+			p.position[c] = floatToHalf(v.position[c] - packed.positionOffset[c]);
+		}
+		p.position[3] = floatToHalf(1.0f);
+
+		encodeOctahedral(v.normal, p.normal);
+
+		for (int c = 0; c < 2; c++) {
+			p.uv[c] = toUnorm16((v.uv[c] - packed.uvOffset[c]) / packed.uvScale[c]);
+		}
+	}
+
+	if (vertices.size() <= 0x10000) {
+		packed.indices16.assign(indices.begin(), indices.end());
+	}
+	else {
+		packed.indices32 = indices;
+	}
+
+	return packed;
+}
+#endif
+
+// Meshlets
+#if 1
+void finishMeshlet(mesh::PackedMesh& packed, mesh::Meshlet& meshlet, const std::vector<mesh::Vertex>& vertices) {
+	using mesh::Vertex;
+
+	const uint32_t* local = &packed.meshletVertices[meshlet.vertexOffset];
+	const uint8_t* triangles = &packed.meshletTriangles[meshlet.triangleOffset];
+
+	float center[3] = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+		for (int c = 0; c < 3; c++) {
+			center[c] += vertices[local[i]].position[c];
+		}
+	}
+
+	float radius = 0.0f;
+	for (int c = 0; c < 3; c++) {
+		center[c] /= meshlet.vertexCount;
+	}
+	for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+		const float* p = vertices[local[i]].position;
+		float dx = p[0] - center[0], dy = p[1] - center[1], dz = p[2] - center[2];
+		radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+	}
+
+	for (int c = 0; c < 3; c++) {
+		meshlet.center[c] = center[c] - packed.positionOffset[c];
+	}
+	meshlet.radius = radius;
+
+	// Cone axis is the average face normal; the cutoff comes from the face
+	// that strays furthest from it.
+	std::vector<float> normals(meshlet.triangleCount * 3);
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+		const float* a = vertices[local[triangles[t * 3]]].position;
+		const float* b = vertices[local[triangles[t * 3 + 1]]].position;
+		const float* c = vertices[local[triangles[t * 3 + 2]]].position;
+
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float n[3] = {
+			e1[1] * e2[2] - e1[2] * e2[1],
+			e1[2] * e2[0] - e1[0] * e2[2],
+			e1[0] * e2[1] - e1[1] * e2[0]
+		};
+
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		for (int k = 0; k < 3; k++) {
+			normals[t * 3 + k] = n[k] * scale;
+			axis[k] += n[k] * scale;
+		}
+	}
+
+	float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	meshlet.coneCutoff = 2.0f;
+	if (axisLength > 0.0f) {
+		float minDot = 1.0f;
+		for (int k = 0; k < 3; k++) {
+			axis[k] /= axisLength;
+		}
+		for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+			const float* n = &normals[t * 3];
+			if (n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f) continue; // degenerate
+
+			minDot = std::min(minDot, n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]);
+		}
+
+		// With every normal within angle a of the axis, the meshlet is
+		// backfacing once the view direction is within 90 - a of it.
+		if (minDot > 0.0f) {
+			meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+	}
+	for (int k = 0; k < 3; k++) {
+		meshlet.coneAxis[k] = axis[k];
+	}
+
+	packed.meshlets.push_back(meshlet);
+}
+
+void mesh::buildMeshlets(PackedMesh& packed, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	const uint8_t notInMeshlet = 0xFF;
+	std::vector<uint8_t> localIndex(vertices.size(), notInMeshlet);
+
+	packed.meshlets.clear();
+	packed.meshletVertices.clear();
+	packed.meshletTriangles.clear();
+
+	Meshlet meshlet = {};
+
+	for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+		const uint32_t* tri = &indices[t];
+
+		uint32_t newVertices = 0;
+		for (int k = 0; k < 3; k++) {
+			if (localIndex[tri[k]] == notInMeshlet) newVertices++;
+		}
+
+		if (meshlet.vertexCount + newVertices > maxMeshletVertices || meshlet.triangleCount + 1 > maxMeshletTriangles) {
+			for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+				localIndex[packed.meshletVertices[meshlet.vertexOffset + i]] = notInMeshlet;
+			}
+
+			finishMeshlet(packed, meshlet, vertices);
+
+			meshlet = {};
+			meshlet.vertexOffset = static_cast<uint32_t>(packed.meshletVertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(packed.meshletTriangles.size());
+		}
+
+		for (int k = 0; k < 3; k++) {
+			if (localIndex[tri[k]] == notInMeshlet) {
+				localIndex[tri[k]] = static_cast<uint8_t>(meshlet.vertexCount++);
+				packed.meshletVertices.push_back(tri[k]);
+			}
+			packed.meshletTriangles.push_back(localIndex[tri[k]]);
+		}
+		meshlet.triangleCount++;
+	}
+
+	if (meshlet.triangleCount > 0) {
+		finishMeshlet(packed, meshlet, vertices);
+	}
+}
+
+bool mesh::isMeshletBackfacing(const Meshlet& meshlet, const float eye[3])
+{
+	float d[3] = { meshlet.center[0] - eye[0], meshlet.center[1] - eye[1], meshlet.center[2] - eye[2] };
+	float distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+
+	return d[0] * meshlet.coneAxis[0] + d[1] * meshlet.coneAxis[1] + d[2] * meshlet.coneAxis[2]
+		>= meshlet.coneCutoff * distance + meshlet.radius;
+}
+#endif
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Offline mesh preparation: reorders a triangle list for the post-transform
+// vertex cache and for vertex fetch, quantizes attributes into PackedVertex,
+// and optionally splits the result into meshlets for cluster culling.
+namespace mesh {
+
+	// What importers produce, before any packing.
+	struct Vertex
+	{
+		float position[3];
+		float normal[3];
+		float uv[2];
+	};
+
+	// 16 bytes instead of 32. Positions are half floats relative to the mesh
+	// center, normals are octahedral-encoded snorm16, and UVs are unorm16
+	// inside the mesh's UV bounds. See shaders/mesh.vert for decoding.
+	struct PackedVertex
+	{
+		uint16_t position[4];
+		int16_t normal[2];
+		uint16_t uv[2];
+	};
+
+	// Up to 64 vertices and 124 triangles, which fits the common mesh shader
+	// limits. Triangles index into this meshlet's slice of meshletVertices.
+	struct Meshlet
+	{
+		uint32_t vertexOffset;
+		uint32_t triangleOffset;
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+
+		// Bounding sphere, in the same space as the packed positions.
+		float center[3];
+		float radius;
+
+		// Normal cone: every face normal is within asin(coneCutoff) of
+		// coneAxis. The whole meshlet faces away from a viewer whenever
+		// dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius,
+		// see isMeshletBackfacing(). The radius term keeps the test
+		// conservative for eyes close to or inside the meshlet. A cutoff
+		// above 1 means the meshlet can't be rejected this way.
+		float coneAxis[3];
+		float coneCutoff;
+	};
+
+	struct PackedMesh
+	{
+		std::vector<PackedVertex> vertices;
+		// 16 bit indices are used whenever the vertex count allows it; only
+		// one of these is filled.
+		std::vector<uint16_t> indices16;
+		std::vector<uint32_t> indices32;
+
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint8_t> meshletTriangles;
+
+		// Add back to decoded positions, and map unorm UVs back to the
+		// original range with uvOffset + uv * uvScale.
+		float positionOffset[3];
+		float boundsRadius;
+		float uvOffset[2];
+		float uvScale[2];
+
+		size_t indexCount() const { return indices16.empty() ? indices32.size() : indices16.size(); }
+	};
+
+	// Vertex shader invocations for a draw, assuming a FIFO post-transform
+	// cache of `cacheSize` entries.
+	struct MeshStats
+	{
+		size_t vertexCount;
+		size_t triangleCount;
+		size_t vertexBytes;
+		size_t indexBytes;
+		size_t vertexShaderInvocations;
+
+		// Average cache miss ratio (invocations per triangle) and average
+		// transform to vertex ratio (invocations per unique vertex).
+		float acmr() const { return triangleCount ? (float)vertexShaderInvocations / triangleCount : 0.0f; }
+		float atvr() const { return vertexCount ? (float)vertexShaderInvocations / vertexCount : 0.0f; }
+	};
+
+	const uint32_t defaultCacheSize = 32;
+	const uint32_t maxMeshletVertices = 64;
+	const uint32_t maxMeshletTriangles = 124;
+
+	MeshStats analyze(const std::vector<uint32_t>& indices, size_t vertexCount, size_t vertexSize, size_t indexSize, uint32_t cacheSize = defaultCacheSize);
+
+	// Tom Forsyth's linear-speed vertex cache optimisation. Rewrites the
+	// triangle order only; vertices are untouched.
+	void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+	// Renumbers vertices in order of first use so the index stream walks the
+	// vertex buffer mostly forwards. Drops vertices no triangle references.
+	void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	PackedMesh quantize(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+	// Greedily groups consecutive triangles, so run optimizeVertexCache first
+	// for tighter meshlets.
+	void buildMeshlets(PackedMesh& packed, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	// The normal cone test. `eye` is in the same space as the meshlet center.
+	bool isMeshletBackfacing(const Meshlet& meshlet, const float eye[3]);
+
+	uint16_t floatToHalf(float value);
+	float halfToFloat(uint16_t value);
+
+}
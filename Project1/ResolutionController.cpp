@@ -0,0 +1,72 @@
+#include "ResolutionController.h"
+
+#include <algorithm>
+#include <cmath>
+
+ResolutionController::ResolutionController() : ResolutionController(Settings())
+{
+}
+
+ResolutionController::ResolutionController(const Settings& s)
+{
+	settings = s;
+	settings.maxScale = std::min(std::max(settings.maxScale, renderScaleStep), 1.0f);
+	settings.minScale = std::min(std::max(settings.minScale, renderScaleStep), settings.maxScale);
+
+	reset(settings.maxScale);
+}
+
+void ResolutionController::reset(float s)
+{
+	scale = std::min(std::max(s, settings.minScale), settings.maxScale);
+	hasSample = false;
+	settle = 0;
+	framesBelow = 0;
+}
+
+void ResolutionController::setScale(float newScale)
+{
+	newScale = std::floor(newScale / renderScaleStep) * renderScaleStep;
+	newScale = std::min(std::max(newScale, settings.minScale), settings.maxScale);
+
+	if (newScale == scale) return;
+
+	scale = newScale;
+	// Start averaging afresh once samples reflect the new scale.
+	hasSample = false;
+	settle = settings.settleFrames;
+	framesBelow = 0;
+}
+
+float ResolutionController::update(double gpuFrameMs)
+{
+	if (gpuFrameMs < 0.0) return scale;
+
+	if (settle > 0) {
+		settle--;
+		return scale;
+	}
+
+	smoothed = hasSample ? smoothed + settings.smoothing * (gpuFrameMs - smoothed) : gpuFrameMs;
+	hasSample = true;
+
+	// Aim for the middle of the dead band, so one correction lands inside it.
+	double aim = settings.targetFrameMs * (settings.lowerThreshold + settings.raiseThreshold) * 0.5;
+	float ideal = scale * static_cast<float>(std::sqrt(aim / std::max(smoothed, 1e-3)));
+
+	if (smoothed > settings.targetFrameMs * settings.lowerThreshold) {
+		setScale(ideal);
+	}
+	else if (smoothed < settings.targetFrameMs * settings.raiseThreshold && scale < settings.maxScale) {
+		if (++framesBelow >= settings.raiseDelayFrames) {
+			// Round to the nearest step rather than down.
+			setScale(std::min(ideal, scale + settings.maxRaiseStep) + renderScaleStep * 0.5f);
+			framesBelow = 0;
+		}
+	}
+	else {
+		framesBelow = 0;
+	}
+
+	return scale;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+// Render scales are multiples of this, so tiny corrections don't change it.
+const float renderScaleStep = 1.0f / 32.0f;
+
+// Picks the render scale (fraction of the output resolution, per axis) that
+// keeps the measured GPU frame time near a target. GPU time is assumed to
+// grow with the pixel count, i.e. with scale squared.
+//
+// There's a dead band between raiseThreshold and lowerThreshold (fractions of
+// the target) where nothing changes, and raising needs raiseDelayFrames good
+// frames in a row, so the scale doesn't oscillate around the target. Going
+// down happens as soon as the smoothed time is over budget.
+class ResolutionController
+{
+public:
+	struct Settings
+	{
+		double targetFrameMs = 1000.0 / 60.0;
+
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+
+		double lowerThreshold = 1.0;
+		double raiseThreshold = 0.8;
+		uint32_t raiseDelayFrames = 30;
+		float maxRaiseStep = 0.05f;
+
+		// Timestamps arrive a few frames late, so after a change this many
+		// samples still describe the old scale and are skipped.
+		uint32_t settleFrames = 3;
+		// Weight of each new sample in the moving average.
+		double smoothing = 0.25;
+	};
+
+	ResolutionController();
+	ResolutionController(const Settings& settings);
+
+	// Feeds one GPU frame time and returns the scale to render at next.
+	float update(double gpuFrameMs);
+	void reset(float scale);
+
+	float getScale() const { return scale; }
+	double getSmoothedFrameMs() const { return smoothed; }
+	const Settings& getSettings() const { return settings; }
+
+private:
+
+	void setScale(float newScale);
+
+	Settings settings;
+
+	float scale;
+	double smoothed = 0.0;
+	bool hasSample = false;
+	uint32_t settle = 0;
+	uint32_t framesBelow = 0;
+
+};
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Pick a backend for the 4-wide math types at compile time. Defining
+// TVKR_MATH_SCALAR forces the portable path, which is also used on targets
+// with neither SSE2 nor NEON.
+#if !defined(TVKR_MATH_SCALAR)
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TVKR_MATH_SSE
+#include <emmintrin.h>
+// MSVC has no FMA macro, but /arch:AVX2 implies it; GCC and Clang need -mfma.
+#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define TVKR_MATH_FMA
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define TVKR_MATH_NEON
+#include <arm_neon.h>
+#else
+#define TVKR_MATH_SCALAR
+#endif
+#endif
+
+#if defined(TVKR_MATH_SSE)
+#define TVKR_MATH_BACKEND "SSE"
+#elif defined(TVKR_MATH_NEON)
+#define TVKR_MATH_BACKEND "NEON"
+#else
+#define TVKR_MATH_BACKEND "scalar"
+#endif
+
+namespace math {
+
+	// Raw 4-lane register for the selected backend, and the handful of
+	// operations the types below are built from.
+#if defined(TVKR_MATH_SSE)
+	typedef __m128 f4;
+
+	inline f4 f4_set(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+	inline f4 f4_splat(float v) { return _mm_set1_ps(v); }
+	inline f4 f4_add(f4 a, f4 b) { return _mm_add_ps(a, b); }
+	inline f4 f4_sub(f4 a, f4 b) { return _mm_sub_ps(a, b); }
+	inline f4 f4_mul(f4 a, f4 b) { return _mm_mul_ps(a, b); }
+	inline f4 f4_div(f4 a, f4 b) { return _mm_div_ps(a, b); }
+	inline f4 f4_min(f4 a, f4 b) { return _mm_min_ps(a, b); }
+	inline f4 f4_max(f4 a, f4 b) { return _mm_max_ps(a, b); }
+#ifdef TVKR_MATH_FMA
+	inline f4 f4_madd(f4 a, f4 b, f4 c) { return _mm_fmadd_ps(a, b, c); }
+#else
+	inline f4 f4_madd(f4 a, f4 b, f4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#endif
+	inline float f4_get(f4 v, int i) { alignas(16) float out[4]; _mm_store_ps(out, v); return out[i]; }
+	inline f4 f4_lane(f4 v, int i) {
+		switch (i) {
+		case 0: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+		case 1: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+		case 2: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+		default: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+		}
+	}
+	inline float f4_hsum(f4 v) {
+		f4 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+		f4 sums = _mm_add_ps(v, shuf);
+		shuf = _mm_movehl_ps(shuf, sums);
+		return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+	}
+#elif defined(TVKR_MATH_NEON)
+	typedef float32x4_t f4;
+
+	inline f4 f4_set(float x, float y, float z, float w) { float v[4] = { x, y, z, w }; return vld1q_f32(v); }
+	inline f4 f4_splat(float v) { return vdupq_n_f32(v); }
+	inline f4 f4_add(f4 a, f4 b) { return vaddq_f32(a, b); }
+	inline f4 f4_sub(f4 a, f4 b) { return vsubq_f32(a, b); }
+	inline f4 f4_mul(f4 a, f4 b) { return vmulq_f32(a, b); }
+	inline f4 f4_div(f4 a, f4 b) {
+		f4 r = vrecpeq_f32(b);
+		r = vmulq_f32(vrecpsq_f32(b, r), r);
+		r = vmulq_f32(vrecpsq_f32(b, r), r);
+		return vmulq_f32(a, r);
+	}
+	inline f4 f4_min(f4 a, f4 b) { return vminq_f32(a, b); }
+	inline f4 f4_max(f4 a, f4 b) { return vmaxq_f32(a, b); }
+	inline f4 f4_madd(f4 a, f4 b, f4 c) { return vmlaq_f32(c, a, b); }
+	inline float f4_get(f4 v, int i) { float out[4]; vst1q_f32(out, v); return out[i]; }
+	inline f4 f4_lane(f4 v, int i) { return vdupq_n_f32(f4_get(v, i)); }
+	inline float f4_hsum(f4 v) {
+		float32x2_t sum = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+		return vget_lane_f32(vpadd_f32(sum, sum), 0);
+	}
+#else
+	struct f4 { float v[4]; };
+
+	inline f4 f4_set(float x, float y, float z, float w) { return { { x, y, z, w } }; }
+	inline f4 f4_splat(float v) { return { { v, v, v, v } }; }
+	inline f4 f4_add(f4 a, f4 b) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+	inline f4 f4_sub(f4 a, f4 b) { return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; }
+	inline f4 f4_mul(f4 a, f4 b) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+	inline f4 f4_div(f4 a, f4 b) { return { { a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3] } }; }
+	inline f4 f4_min(f4 a, f4 b) { return { { fminf(a.v[0], b.v[0]), fminf(a.v[1], b.v[1]), fminf(a.v[2], b.v[2]), fminf(a.v[3], b.v[3]) } }; }
+	inline f4 f4_max(f4 a, f4 b) { return { { fmaxf(a.v[0], b.v[0]), fmaxf(a.v[1], b.v[1]), fmaxf(a.v[2], b.v[2]), fmaxf(a.v[3], b.v[3]) } }; }
+	inline f4 f4_madd(f4 a, f4 b, f4 c) { return f4_add(f4_mul(a, b), c); }
+	inline float f4_get(f4 v, int i) { return v.v[i]; }
+	inline f4 f4_lane(f4 v, int i) { return f4_splat(v.v[i]); }
+	inline float f4_hsum(f4 v) { return (v.v[0] + v.v[1]) + (v.v[2] + v.v[3]); }
+#endif
+
+	struct alignas(16) vec4
+	{
+		f4 v;
+
+		vec4() : v(f4_splat(0.0f)) {}
+		explicit vec4(f4 raw) : v(raw) {}
+		explicit vec4(float s) : v(f4_splat(s)) {}
+		vec4(float x, float y, float z, float w) : v(f4_set(x, y, z, w)) {}
+
+		float x() const { return f4_get(v, 0); }
+		float y() const { return f4_get(v, 1); }
+		float z() const { return f4_get(v, 2); }
+		float w() const { return f4_get(v, 3); }
+		float operator[](int i) const { return f4_get(v, i); }
+
+		vec4 operator+(const vec4& o) const { return vec4(f4_add(v, o.v)); }
+		vec4 operator-(const vec4& o) const { return vec4(f4_sub(v, o.v)); }
+		vec4 operator*(const vec4& o) const { return vec4(f4_mul(v, o.v)); }
+		vec4 operator/(const vec4& o) const { return vec4(f4_div(v, o.v)); }
+		vec4 operator*(float s) const { return vec4(f4_mul(v, f4_splat(s))); }
+		vec4 operator-() const { return vec4(f4_sub(f4_splat(0.0f), v)); }
+
+		vec4& operator+=(const vec4& o) { v = f4_add(v, o.v); return *this; }
+		vec4& operator-=(const vec4& o) { v = f4_sub(v, o.v); return *this; }
+		vec4& operator*=(float s) { v = f4_mul(v, f4_splat(s)); return *this; }
+	};
+
+	// Points carry w = 1 so they pick up translation, directions carry w = 0.
+	inline vec4 point(float x, float y, float z) { return vec4(x, y, z, 1.0f); }
+	inline vec4 direction(float x, float y, float z) { return vec4(x, y, z, 0.0f); }
+
+	inline float dot(const vec4& a, const vec4& b) { return f4_hsum(f4_mul(a.v, b.v)); }
+	inline float dot3(const vec4& a, const vec4& b) { return a.x() * b.x() + a.y() * b.y() + a.z() * b.z(); }
+	inline vec4 cross(const vec4& a, const vec4& b) {
+		return direction(
+			a.y() * b.z() - a.z() * b.y(),
+			a.z() * b.x() - a.x() * b.z(),
+			a.x() * b.y() - a.y() * b.x());
+	}
+	inline float length(const vec4& a) { return std::sqrt(dot(a, a)); }
+	inline float length3(const vec4& a) { return std::sqrt(dot3(a, a)); }
+	inline vec4 normalize(const vec4& a) { return a * (1.0f / length(a)); }
+	inline vec4 normalize3(const vec4& a) { return a * (1.0f / length3(a)); }
+	inline vec4 min(const vec4& a, const vec4& b) { return vec4(f4_min(a.v, b.v)); }
+	inline vec4 max(const vec4& a, const vec4& b) { return vec4(f4_max(a.v, b.v)); }
+	inline vec4 lerp(const vec4& a, const vec4& b, float t) { return vec4(f4_madd(f4_sub(b.v, a.v), f4_splat(t), a.v)); }
+
+	// Rotation stored as (x, y, z, w) with w the real part.
+	struct quat
+	{
+		vec4 q;
+
+		quat() : q(0.0f, 0.0f, 0.0f, 1.0f) {}
+		quat(float x, float y, float z, float w) : q(x, y, z, w) {}
+		explicit quat(const vec4& v) : q(v) {}
+
+		static quat axisAngle(const vec4& axis, float radians) {
+			vec4 n = normalize3(axis);
+			float s = std::sin(radians * 0.5f);
+			return quat(n.x() * s, n.y() * s, n.z() * s, std::cos(radians * 0.5f));
+		}
+
+		quat operator*(const quat& o) const {
+			float ax = q.x(), ay = q.y(), az = q.z(), aw = q.w();
+			float bx = o.q.x(), by = o.q.y(), bz = o.q.z(), bw = o.q.w();
+			return quat(
+				aw * bx + ax * bw + ay * bz - az * by,
+				aw * by - ax * bz + ay * bw + az * bx,
+				aw * bz + ax * by - ay * bx + az * bw,
+				aw * bw - ax * bx - ay * by - az * bz);
+		}
+
+		quat conjugate() const { return quat(-q.x(), -q.y(), -q.z(), q.w()); }
+
+		// v' = v + 2w(u x v) + 2(u x (u x v)), with u the vector part
+		vec4 rotate(const vec4& v) const {
+			vec4 u = direction(q.x(), q.y(), q.z());
+			vec4 t = cross(u, v) * 2.0f;
+			return v + t * q.w() + cross(u, t);
+		}
+	};
+
+	inline quat normalize(const quat& a) { return quat(normalize(a.q)); }
+
+	// Normalized lerp along the shorter arc; close enough to slerp for
+	// animation-sized steps and much cheaper.
+	inline quat nlerp(const quat& a, const quat& b, float t) {
+		vec4 target = dot(a.q, b.q) < 0.0f ? -b.q : b.q;
+		return quat(normalize(lerp(a.q, target, t)));
+	}
+
+	// Column-major, matching GLSL, so it can be copied straight into buffers.
+	struct alignas(16) mat4
+	{
+		vec4 cols[4];
+
+		mat4() {}
+		mat4(const vec4& c0, const vec4& c1, const vec4& c2, const vec4& c3) {
+			cols[0] = c0;
+			cols[1] = c1;
+			cols[2] = c2;
+			cols[3] = c3;
+		}
+
+		static mat4 identity() {
+			return mat4(
+				vec4(1.0f, 0.0f, 0.0f, 0.0f),
+				vec4(0.0f, 1.0f, 0.0f, 0.0f),
+				vec4(0.0f, 0.0f, 1.0f, 0.0f),
+				vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		}
+
+		static mat4 translation(float x, float y, float z) {
+			mat4 m = identity();
+			m.cols[3] = point(x, y, z);
+			return m;
+		}
+
+		static mat4 scaling(float x, float y, float z) {
+			return mat4(
+				vec4(x, 0.0f, 0.0f, 0.0f),
+				vec4(0.0f, y, 0.0f, 0.0f),
+				vec4(0.0f, 0.0f, z, 0.0f),
+				vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		}
+
+		static mat4 rotation(const quat& r) {
+			float x = r.q.x(), y = r.q.y(), z = r.q.z(), w = r.q.w();
+			return mat4(
+				direction(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y)),
+				direction(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x)),
+				direction(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y)),
+				vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		}
+
+		// Right handed, depth mapped to [0, 1] and Y pointing down in clip
+		// space, as Vulkan expects.
+		static mat4 perspective(float fovyRadians, float aspect, float zNear, float zFar) {
+			float f = 1.0f / std::tan(fovyRadians * 0.5f);
+			return mat4(
+				vec4(f / aspect, 0.0f, 0.0f, 0.0f),
+				vec4(0.0f, -f, 0.0f, 0.0f),
+				vec4(0.0f, 0.0f, zFar / (zNear - zFar), -1.0f),
+				vec4(0.0f, 0.0f, (zNear * zFar) / (zNear - zFar), 0.0f));
+		}
+
+		static mat4 lookAt(const vec4& eye, const vec4& center, const vec4& up) {
+			vec4 f = normalize3(center - eye);
+			vec4 s = normalize3(cross(f, up));
+			vec4 u = cross(s, f);
+			return mat4(
+				vec4(s.x(), u.x(), -f.x(), 0.0f),
+				vec4(s.y(), u.y(), -f.y(), 0.0f),
+				vec4(s.z(), u.z(), -f.z(), 0.0f),
+				vec4(-dot3(s, eye), -dot3(u, eye), dot3(f, eye), 1.0f));
+		}
+
+		vec4 row(int i) const { return vec4(cols[0][i], cols[1][i], cols[2][i], cols[3][i]); }
+
+		vec4 operator*(const vec4& v) const {
+			f4 r = f4_mul(cols[0].v, f4_lane(v.v, 0));
+			r = f4_madd(cols[1].v, f4_lane(v.v, 1), r);
+			r = f4_madd(cols[2].v, f4_lane(v.v, 2), r);
+			r = f4_madd(cols[3].v, f4_lane(v.v, 3), r);
+			return vec4(r);
+		}
+
+		mat4 operator*(const mat4& o) const {
+			return mat4(*this * o.cols[0], *this * o.cols[1], *this * o.cols[2], *this * o.cols[3]);
+		}
+
+		mat4 transpose() const { return mat4(row(0), row(1), row(2), row(3)); }
+
+		// Copies out the 16 floats in column-major order.
+		void store(float out[16]) const {
+			for (int c = 0; c < 4; c++) {
+				for (int r = 0; r < 4; r++) {
+					out[c * 4 + r] = cols[c][r];
+				}
+			}
+		}
+	};
+
+}
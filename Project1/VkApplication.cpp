@@ -2,12 +2,15 @@
 #include "TVkR.h"
 
 #define LOAD_DEBUG_REPORT
+#define LOAD_PHYSICAL_DEVICE_PROPERTIES2
 #include "VkExtensions.h"
 
 #include "utils.h"
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <set>
 
 #ifdef USE_VALIDATION
@@ -22,7 +25,7 @@ const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
-VkApplication::VkApplication(int w, int h, std::string nam, Version ver)
+VkApplication::VkApplication(int w, int h, std::string nam, Version ver, bool off)
 {
 	destructed = false;
 
@@ -32,6 +35,8 @@ VkApplication::VkApplication(int w, int h, std::string nam, Version ver)
 	app_name = nam;
 
 	version = ver;
+
+	offscreen = off;
 }
 
 VkApplication::~VkApplication()
@@ -41,12 +46,19 @@ VkApplication::~VkApplication()
 
 void VkApplication::run()
 {
-	initWindow();
-	initVulkan();
+	init();
 	mainLoop();
+	// Reports a failed capture write, which cleanup() has to ignore.
+	capture.stop();
 	cleanup();
 }
 
+void VkApplication::init()
+{
+	if (!offscreen) initWindow();
+	initVulkan();
+}
+
 void VkApplication::initWindow()
 {
 	glfwInit();
@@ -97,15 +109,33 @@ bool checkValidationSupport() {
 }
 #endif
 
-std::vector<const char*> getNeededExtensions() {
+bool checkInstanceExtensionSupport(const char* name) {
+	uint32_t extensionCount;
+	vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions) {
+		if (strcmp(name, extension.extensionName) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::vector<const char*> getNeededExtensions(bool offscreen) {
 	std::vector<const char*> extensions;
 
-	unsigned int glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	if (!offscreen) {
+		unsigned int glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-	for (unsigned int i = 0; i < glfwExtensionCount; i++) {
-		extensions.push_back(glfwExtensions[i]);
+		for (unsigned int i = 0; i < glfwExtensionCount; i++) {
+			extensions.push_back(glfwExtensions[i]);
+		}
 	}
 
 #ifdef USE_VALIDATION
@@ -135,7 +165,14 @@ void VkApplication::createInstance()
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	createInfo.pApplicationInfo = &appInfo;
 
-	auto extensions = getNeededExtensions();
+	auto extensions = getNeededExtensions(offscreen);
+
+	// Needed to query extended device features, such as descriptor indexing
+	hasProperties2 = checkInstanceExtensionSupport(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	if (hasProperties2) {
+		extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 	createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -153,6 +190,8 @@ void VkApplication::createInstance()
 
 void VkApplication::createSurface()
 {
+	if (offscreen) return;
+
 	if (glfwCreateWindowSurface(inst, window, nullptr, &surface) != VK_SUCCESS) {
 		ERROR("Failed to create window surface!");
 	}
@@ -194,11 +233,13 @@ QueueFamilies findQueueFamilies(VkApplication* app, VkPhysicalDevice device) {
 		QUEUEFAMILY_BITCHECK(TRANSFER)
 		QUEUEFAMILY_BITCHECK(SPARSE_BINDING)
 
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, app->getSurface(), &presentSupport);
+		if (app->getSurface() != VK_NULL_HANDLE) {
+			VkBool32 presentSupport = false;
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, app->getSurface(), &presentSupport);
 
-		if (queueFamily.queueCount > 0 && presentSupport) {
-			families.presenter = i;
+			if (queueFamily.queueCount > 0 && presentSupport) {
+				families.presenter = i;
+			}
 		}
 
 		if (families.hasAll()) {
@@ -230,6 +271,93 @@ bool checkExtensionSupport(VkPhysicalDevice device) {
 	return requiredExtensions.empty();
 }
 
+bool checkDeviceExtensionSupport(VkPhysicalDevice device, const char* name) {
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions) {
+		if (strcmp(name, extension.extensionName) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+DescriptorIndexingSupport queryDescriptorIndexingSupport(VkInstance inst, bool hasProperties2, VkPhysicalDevice device) {
+	DescriptorIndexingSupport support;
+
+#ifdef VK_EXT_descriptor_indexing
+	if (!hasProperties2
+		|| !checkDeviceExtensionSupport(device, VK_KHR_MAINTENANCE3_EXTENSION_NAME)
+		|| !checkDeviceExtensionSupport(device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+		return support;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2KHR features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+	features.pNext = &indexingFeatures;
+	GetPhysicalDeviceFeatures2KHR(inst, device, &features);
+
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+	VkPhysicalDeviceProperties2KHR properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+	properties.pNext = &indexingProperties;
+	GetPhysicalDeviceProperties2KHR(inst, device, &properties);
+
+	support.supported = indexingFeatures.runtimeDescriptorArray
+		&& indexingFeatures.descriptorBindingPartiallyBound
+		&& indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+		&& indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind
+		&& indexingFeatures.shaderSampledImageArrayNonUniformIndexing
+		&& indexingFeatures.shaderStorageBufferArrayNonUniformIndexing;
+
+	support.maxSampledImages = std::min(indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages);
+	support.maxStorageBuffers = std::min(indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers, indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+	support.maxSamplers = std::min(indexingProperties.maxDescriptorSetUpdateAfterBindSamplers, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers);
+	support.maxPerStageResources = indexingProperties.maxPerStageUpdateAfterBindResources;
+#endif
+
+	return support;
+}
+
+MemoryBudgetSupport queryMemoryBudgetSupport(VkInstance inst, bool hasProperties2, VkPhysicalDevice device) {
+	MemoryBudgetSupport support;
+
+	// Both are read through the properties2/features2 queries.
+	if (!hasProperties2) {
+		return support;
+	}
+
+#ifdef VK_EXT_memory_budget
+	support.budget = checkDeviceExtensionSupport(device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+#endif
+
+#ifdef VK_EXT_memory_priority
+	if (checkDeviceExtensionSupport(device, VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME)) {
+		VkPhysicalDeviceMemoryPriorityFeaturesEXT priorityFeatures = {};
+		priorityFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PRIORITY_FEATURES_EXT;
+
+		VkPhysicalDeviceFeatures2KHR features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features.pNext = &priorityFeatures;
+		GetPhysicalDeviceFeatures2KHR(inst, device, &features);
+
+		support.priority = priorityFeatures.memoryPriority == VK_TRUE;
+	}
+#endif
+
+	return support;
+}
+
 // Swap chain block
 #if 1
 struct SwapChainSupportDetails {
@@ -325,8 +453,28 @@ void VkApplication::createSwapChain() {
 	createInfo.imageColorSpace = surfaceFormat.colorSpace;
 	createInfo.imageExtent = extent;
 	createInfo.imageArrayLayers = 1;
+
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+	// The scene is rendered into renderTarget and blitted in. Only
+	// COLOR_ATTACHMENT is guaranteed though, so otherwise it's rendered
+	// straight into the images.
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, surfaceFormat.format, &formatProperties);
+
+	VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+	directOutput = !(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+		|| (formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures;
+	if (!directOutput) {
+		createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+
+	// Lets frame capture copy out of the presented images.
+	swapChainTransferSrc = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+	if (swapChainTransferSrc) {
+		createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
 	QueueFamilies indices = findQueueFamilies(this, physicalDevice);
 	uint32_t queueFamilyIndices[] = { (uint32_t)indices.GRAPHICS, (uint32_t)indices.presenter };
 
@@ -360,14 +508,23 @@ void VkApplication::createSwapChain() {
 }
 #endif
 
-bool scoreDevice(VkApplication* app, VkPhysicalDevice device) {
+// Also reports the device's descriptor indexing support, which doesn't rule
+// a device out but picks the bindless path later.
+bool scoreDevice(VkApplication* app, VkPhysicalDevice device, DescriptorIndexingSupport& descriptorIndexing) {
 	VkPhysicalDeviceProperties deviceProperties;
 	VkPhysicalDeviceFeatures deviceFeatures;
 	vkGetPhysicalDeviceProperties(device, &deviceProperties);
 	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+
+	descriptorIndexing = queryDescriptorIndexingSupport(app->getInstance(), app->hasPhysicalDeviceProperties2(), device);
 	
 	QueueFamilies families = findQueueFamilies(app, device);
 
+	// Offscreen rendering only needs a graphics queue.
+	if (app->isOffscreen()) {
+		return families.GRAPHICS != -1;
+	}
+
 	bool supportsExtensions = checkExtensionSupport(device);
 
 	bool goodSwapChain = false;
@@ -392,8 +549,17 @@ void VkApplication::pickDevice()
 	vkEnumeratePhysicalDevices(inst, &deviceCount, devices.data());
 
 	for (const auto& device : devices) {
-		if (scoreDevice(this, device)) {
+		DescriptorIndexingSupport indexing;
+		if (!scoreDevice(this, device, indexing)) continue;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(device, &properties);
+
+		if (physicalDevice == VK_NULL_HANDLE || properties.deviceType == preferredDeviceType) {
 			physicalDevice = device;
+			descriptorIndexing = indexing;
+		}
+		if (properties.deviceType == preferredDeviceType) {
 			break;
 		}
 	}
@@ -401,6 +567,10 @@ void VkApplication::pickDevice()
 	if (physicalDevice == VK_NULL_HANDLE) {
 		ERROR("failed to find a suitable GPU!");
 	}
+
+	vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	memoryBudgetSupport = queryMemoryBudgetSupport(inst, hasProperties2, physicalDevice);
 }
 
 void VkApplication::createLogicalDevice()
@@ -408,7 +578,10 @@ void VkApplication::createLogicalDevice()
 	QueueFamilies indices = findQueueFamilies(this, physicalDevice);
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<int> uniqueQueueFamilies = { indices.GRAPHICS, indices.presenter };
+	std::set<int> uniqueQueueFamilies = { indices.GRAPHICS };
+	if (!offscreen) {
+		uniqueQueueFamilies.insert(indices.presenter);
+	}
 
 	float queuePriority = 1.0f;
 	for (int queueFamily : uniqueQueueFamilies) {
@@ -422,6 +595,11 @@ void VkApplication::createLogicalDevice()
 
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 
+	std::vector<const char*> extensions;
+	if (!offscreen) {
+		extensions = deviceExtensions;
+	}
+
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
@@ -429,8 +607,53 @@ void VkApplication::createLogicalDevice()
 
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	// Extension feature structs are chained in front of this.
+	void* featureChain = nullptr;
+
+#ifdef VK_EXT_descriptor_indexing
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	if (descriptorIndexing.supported) {
+		extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+		indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+		indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		indexingFeatures.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+
+		indexingFeatures.pNext = featureChain;
+		featureChain = &indexingFeatures;
+	}
+#endif
+
+#ifdef VK_EXT_memory_budget
+	if (memoryBudgetSupport.budget) {
+		extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+#endif
+
+#ifdef VK_EXT_memory_priority
+	VkPhysicalDeviceMemoryPriorityFeaturesEXT priorityFeatures = {};
+	priorityFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PRIORITY_FEATURES_EXT;
+
+	if (memoryBudgetSupport.priority) {
+		extensions.push_back(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME);
+
+		priorityFeatures.memoryPriority = VK_TRUE;
+
+		priorityFeatures.pNext = featureChain;
+		featureChain = &priorityFeatures;
+	}
+#endif
+
+	createInfo.pNext = featureChain;
+
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 #ifdef USE_VALIDATION
 	createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -444,7 +667,9 @@ void VkApplication::createLogicalDevice()
 	}
 
 	vkGetDeviceQueue(device, indices.GRAPHICS, 0, &graphicsQueue);
-	vkGetDeviceQueue(device, indices.presenter, 0, &presentQueue);
+	if (!offscreen) {
+		vkGetDeviceQueue(device, indices.presenter, 0, &presentQueue);
+	}
 }
 #endif
 
@@ -460,13 +685,174 @@ void VkApplication::initVulkan()
 	pickDevice();
 
 	createLogicalDevice();
-	createSwapChain();
-	createImageViews();
+	memoryBudget.create(inst, physicalDevice, device, memoryBudgetSupport);
+
+	if (offscreen) {
+		createOffscreenTarget();
+	}
+	else {
+		createSwapChain();
+	}
+
+	if (directOutput) {
+		createImageViews();
+	}
+	else {
+		createRenderTarget();
+	}
+
+	bindlessTable.create(device, descriptorIndexing, physicalDeviceProperties.limits, &memoryBudget);
 
+	createRenderPass();
 	createGFXPipleine();
+	createFramebuffers();
+	createCommandBuffers();
+
+	VkCommandBuffer setupCommands = beginOneShotCommands();
+	bindlessTable.recordSetup(setupCommands);
+	endOneShotCommands(setupCommands);
+
+	createSyncObjects();
+	createTimestampQueries();
+
+	capture.create(device, &memoryBudget);
+	if (captureSink) {
+		startCapture(captureSink);
+	}
 }
 
-void VkApplication::createImageViews() {
+// Memory
+#if 1
+uint32_t VkApplication::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	ERROR("Failed to find a suitable memory type!");
+}
+
+VkDeviceMemory VkApplication::allocateMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryCategory category)
+{
+	return memoryBudget.allocate(requirements.size, findMemoryType(requirements.memoryTypeBits, properties), category);
+}
+
+void VkApplication::freeMemory(VkDeviceMemory memory)
+{
+	memoryBudget.free(memory);
+}
+
+void VkApplication::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category, VkBuffer& buffer, VkDeviceMemory& memory)
+{
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+		ERROR("Failed to create buffer!");
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+	memory = allocateMemory(requirements, properties, category);
+	vkBindBufferMemory(device, buffer, memory, 0);
+}
+#endif
+
+void VkApplication::createOffscreenTarget()
+{
+	imageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	swapChainExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = imageFormat;
+	imageInfo.extent = { swapChainExtent.width, swapChainExtent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (vkCreateImage(device, &imageInfo, nullptr, &offscreenImage) != VK_SUCCESS) {
+		ERROR("Failed to create offscreen image!");
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, offscreenImage, &requirements);
+
+	offscreenMemory = allocateMemory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::RENDER_TARGETS);
+	vkBindImageMemory(device, offscreenImage, offscreenMemory, 0);
+
+	swapChainImages = { offscreenImage };
+	swapChainTransferSrc = true;
+}
+
+void VkApplication::createRenderTarget()
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
+
+	VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+	if ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures) {
+		ERROR("The output format doesn't support blits!");
+	}
+
+	upscaleFilter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = imageFormat;
+	imageInfo.extent = { swapChainExtent.width, swapChainExtent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (vkCreateImage(device, &imageInfo, nullptr, &renderTarget) != VK_SUCCESS) {
+		ERROR("Failed to create render target!");
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, renderTarget, &requirements);
+
+	renderTargetMemory = allocateMemory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::RENDER_TARGETS);
+	vkBindImageMemory(device, renderTarget, renderTargetMemory, 0);
+
+	VkImageViewCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	createInfo.image = renderTarget;
+	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	createInfo.format = imageFormat;
+	createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+	createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+	createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+	createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	createInfo.subresourceRange.baseMipLevel = 0;
+	createInfo.subresourceRange.levelCount = 1;
+	createInfo.subresourceRange.baseArrayLayer = 0;
+	createInfo.subresourceRange.layerCount = 1;
+
+	if (vkCreateImageView(device, &createInfo, nullptr, &renderTargetView) != VK_SUCCESS) {
+		ERROR("Failed to create image views!");
+	}
+}
+
+void VkApplication::createImageViews()
+{
 	swapChainImageViews.resize(swapChainImages.size());
 
 	for (size_t i = 0; i < swapChainImages.size(); i++) {
@@ -484,7 +870,7 @@ void VkApplication::createImageViews() {
 		createInfo.subresourceRange.levelCount = 1;
 		createInfo.subresourceRange.baseArrayLayer = 0;
 		createInfo.subresourceRange.layerCount = 1;
-		
+
 		if (vkCreateImageView(device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS) {
 			ERROR("Failed to create image views!");
 		}
@@ -514,40 +900,643 @@ void VkApplication::createGFXPipleine() {
 	VkShaderModule vertShaderModule = createShaderModule(&device, vertShaderCode);
 	VkShaderModule fragShaderModule = createShaderModule(&device, fragShaderCode);
 
-
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertShaderModule;
+	shaderStages[0].pName = "main";
+
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragShaderModule;
+	shaderStages[1].pName = "main";
+
+	// The triangle comes from gl_VertexIndex, so there are no vertex buffers.
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = 0;
+	vertexInputInfo.vertexAttributeDescriptionCount = 0;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	// Viewport and scissor are set while recording, so the pipeline doesn't
+	// depend on the render target size.
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer = {};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending = {};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = bindlessTable.getPipelineLayout();
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = 0;
+
+	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+		ERROR("Failed to create graphics pipeline!");
+	}
 
 	vkDestroyShaderModule(device, fragShaderModule, nullptr);
 	vkDestroyShaderModule(device, vertShaderModule, nullptr);
 }
 #endif
 
+void VkApplication::createRenderPass()
+{
+	VkAttachmentDescription colorAttachment = {};
+	colorAttachment.format = imageFormat;
+	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	colorAttachment.finalLayout = directOutput ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	VkAttachmentReference colorAttachmentRef = {};
+	colorAttachmentRef.attachment = 0;
+	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorAttachmentRef;
+
+	// Wait for the previous frame's rendering and upscale blit (or the
+	// acquire, with directOutput) before clearing, and make this frame's
+	// rendering visible to its blit or capture copy.
+	VkSubpassDependency dependencies[2] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments = &colorAttachment;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+	renderPassInfo.dependencyCount = 2;
+	renderPassInfo.pDependencies = dependencies;
+
+	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+		ERROR("Failed to create render pass!");
+	}
+}
+
+void VkApplication::createFramebuffers()
+{
+	std::vector<VkImageView> attachments = directOutput ? swapChainImageViews : std::vector<VkImageView>{ renderTargetView };
+	framebuffers.resize(attachments.size());
+
+	for (size_t i = 0; i < attachments.size(); i++) {
+		VkFramebufferCreateInfo framebufferInfo = {};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = renderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &attachments[i];
+		framebufferInfo.width = swapChainExtent.width;
+		framebufferInfo.height = swapChainExtent.height;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffers[i]) != VK_SUCCESS) {
+			ERROR("Failed to create framebuffer!");
+		}
+	}
+}
+
+// Frame loop
+#if 1
+void VkApplication::createCommandBuffers()
+{
+	QueueFamilies indices = findQueueFamilies(this, physicalDevice);
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = indices.GRAPHICS;
+
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		ERROR("Failed to create command pool!");
+	}
+
+	commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+	if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+		ERROR("Failed to allocate command buffers!");
+	}
+}
+
+void VkApplication::createSyncObjects()
+{
+	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	// Start signaled so the first wait on each frame returns immediately.
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+			vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
+			vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+			ERROR("Failed to create synchronization objects for a frame!");
+		}
+	}
+}
+
+void VkApplication::createTimestampQueries()
+{
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	timestampValidBits = queueFamilies[findQueueFamilies(this, physicalDevice).GRAPHICS].timestampValidBits;
+	timestampsWritten.assign(MAX_FRAMES_IN_FLIGHT, false);
+	if (timestampValidBits == 0) return;
+
+	VkQueryPoolCreateInfo queryPoolInfo = {};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+
+	if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampPool) != VK_SUCCESS) {
+		ERROR("Failed to create timestamp query pool!");
+	}
+}
+
+// Called once the frame's fence has signaled, so the results are ready.
+// Returns whether lastGPUTime was updated.
+bool VkApplication::collectTimestamps(size_t frame)
+{
+	if (timestampPool == VK_NULL_HANDLE || !timestampsWritten[frame]) return false;
+
+	uint64_t timestamps[2];
+	if (vkGetQueryPoolResults(device, timestampPool, static_cast<uint32_t>(frame * 2), 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		return false;
+	}
+
+	uint64_t mask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+	uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+	lastGPUTime = ticks * static_cast<double>(physicalDeviceProperties.limits.timestampPeriod) / 1e6;
+	return true;
+}
+
+// Dynamic resolution
+#if 1
+VkExtent2D VkApplication::getRenderExtent()
+{
+	if (directOutput) return swapChainExtent;
+
+	VkExtent2D extent;
+	extent.width = std::min(swapChainExtent.width, std::max(1u, static_cast<uint32_t>(swapChainExtent.width * renderScale + 0.5f)));
+	extent.height = std::min(swapChainExtent.height, std::max(1u, static_cast<uint32_t>(swapChainExtent.height * renderScale + 0.5f)));
+	return extent;
+}
+
+void VkApplication::setRenderScale(float scale)
+{
+	renderScale = std::min(std::max(scale, renderScaleStep), 1.0f);
+	dynamicResolution = false;
+}
+
+void VkApplication::enableDynamicResolution(const ResolutionController::Settings& settings)
+{
+	resolutionController = ResolutionController(settings);
+	resolutionController.reset(renderScale);
+	renderScale = resolutionController.getScale();
+	dynamicResolution = true;
+}
+
+// Scales the rendered part of renderTarget up to the whole output image and
+// leaves that in `outputLayout`.
+void blitToOutput(VkCommandBuffer commandBuffer, VkImage source, VkExtent2D sourceExtent, VkImage output, VkExtent2D outputExtent, VkImageLayout outputLayout, VkFilter filter) {
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	// The old contents are overwritten entirely.
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = output;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.layerCount = 1;
+
+	// TRANSFER covers both the swap chain acquire (submitted to wait there)
+	// and copies still reading the last frame from an offscreen output.
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkImageBlit blit = {};
+	blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.srcSubresource.layerCount = 1;
+	blit.srcOffsets[1] = { static_cast<int32_t>(sourceExtent.width), static_cast<int32_t>(sourceExtent.height), 1 };
+	blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.dstSubresource.layerCount = 1;
+	blit.dstOffsets[1] = { static_cast<int32_t>(outputExtent.width), static_cast<int32_t>(outputExtent.height), 1 };
+
+	vkCmdBlitImage(commandBuffer, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, output, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, filter);
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = outputLayout;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+}
+#endif
+
+void VkApplication::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		ERROR("Failed to begin recording command buffer!");
+	}
+
+	uint32_t firstQuery = static_cast<uint32_t>(currentFrame * 2);
+	if (timestampPool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(commandBuffer, timestampPool, firstQuery, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, firstQuery);
+	}
+
+	VkExtent2D renderExtent = getRenderExtent();
+
+	VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	VkRenderPassBeginInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = renderPass;
+	renderPassInfo.framebuffer = framebuffers[directOutput ? imageIndex : 0];
+	renderPassInfo.renderArea.offset = { 0, 0 };
+	renderPassInfo.renderArea.extent = renderExtent;
+	renderPassInfo.clearValueCount = 1;
+	renderPassInfo.pClearValues = &clearColor;
+
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	bindlessTable.bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+	VkViewport viewport = {};
+	viewport.width = static_cast<float>(renderExtent.width);
+	viewport.height = static_cast<float>(renderExtent.height);
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor = { { 0, 0 }, renderExtent };
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	for (uint32_t i = 0; i < scene.drawCount; i++) {
+		vkCmdDraw(commandBuffer, 3, scene.instanceCount, 0, 0);
+	}
+
+	vkCmdEndRenderPass(commandBuffer);
+
+	VkImageLayout outputLayout = offscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	if (!directOutput) {
+		blitToOutput(commandBuffer, renderTarget, renderExtent, swapChainImages[imageIndex], swapChainExtent, outputLayout, upscaleFilter);
+	}
+
+	capture.record(commandBuffer, swapChainImages[imageIndex], outputLayout);
+
+	if (timestampPool != VK_NULL_HANDLE) {
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, firstQuery + 1);
+	}
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		ERROR("Failed to record command buffer!");
+	}
+}
+
+void VkApplication::drawFrame()
+{
+	vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	if (collectTimestamps(currentFrame) && dynamicResolution && !directOutput) {
+		renderScale = resolutionController.update(lastGPUTime);
+	}
+	capture.poll();
+
+	// Everything before the other frames in flight has finished by now.
+	uint64_t oldestFrameInFlight = frameNumber + 1 >= MAX_FRAMES_IN_FLIGHT ? frameNumber + 1 - MAX_FRAMES_IN_FLIGHT : 0;
+	memoryBudget.update(frameNumber, oldestFrameInFlight);
+
+	uint32_t imageIndex = 0;
+	if (!offscreen) {
+		VkResult result = vkAcquireNextImageKHR(device, swapChain, std::numeric_limits<uint64_t>::max(), imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+			ERROR("Failed to acquire swap chain image!");
+		}
+	}
+
+	// Without UPDATE_AFTER_BIND the set must not be in use while it's written.
+	if (bindlessTable.hasPendingWrites() && !bindlessTable.isBindless()) {
+		vkDeviceWaitIdle(device);
+	}
+	bindlessTable.flush();
+
+	vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+	recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+	timestampsWritten[currentFrame] = timestampPool != VK_NULL_HANDLE;
+
+	// The swap chain image is first touched by the upscale blit, or by the
+	// render pass with directOutput.
+	VkPipelineStageFlags waitStage = directOutput ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+
+	if (!offscreen) {
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &imageAvailableSemaphores[currentFrame];
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &renderFinishedSemaphores[currentFrame];
+	}
+
+	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+		ERROR("Failed to submit draw command buffer!");
+	}
+	capture.submitted(graphicsQueue);
+
+	if (!offscreen) {
+		VkPresentInfoKHR presentInfo = {};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = &swapChain;
+		presentInfo.pImageIndices = &imageIndex;
+
+		VkResult result = vkQueuePresentKHR(presentQueue, &presentInfo);
+		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+			ERROR("Failed to present swap chain image!");
+		}
+	}
+
+	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	frameNumber++;
+}
+
+void VkApplication::waitIdle()
+{
+	vkDeviceWaitIdle(device);
+
+	// Pick up the timings of whatever was still in flight.
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		size_t frame = (currentFrame + i) % MAX_FRAMES_IN_FLIGHT;
+		collectTimestamps(frame);
+		timestampsWritten[frame] = false;
+	}
+}
+#endif
+
+void VkApplication::startCapture(FrameSink* sink)
+{
+	captureSink = sink;
+	if (device == VK_NULL_HANDLE) return;
+
+	if (!swapChainTransferSrc) {
+		ERROR("The swap chain images don't support being copied from, so frames can't be captured!");
+	}
+
+	capture.start(sink, swapChainExtent, imageFormat);
+}
+
+void VkApplication::stopCapture()
+{
+	captureSink = nullptr;
+	capture.stop();
+}
+
+VkCommandBuffer VkApplication::beginOneShotCommands()
+{
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
+}
+
+void VkApplication::endOneShotCommands(VkCommandBuffer commandBuffer)
+{
+	vkEndCommandBuffer(commandBuffer);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(graphicsQueue);
+
+	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+}
+
+void VkApplication::readbackFrame(std::vector<uint8_t>& pixels)
+{
+	if (!offscreen) {
+		ERROR("Frames can only be read back from an offscreen application!");
+	}
+
+	// Before that the image has no contents and is still UNDEFINED.
+	if (frameNumber == 0) {
+		ERROR("No frame has been drawn to read back yet!");
+	}
+
+	waitIdle();
+
+	VkDeviceSize size = VkDeviceSize(swapChainExtent.width) * swapChainExtent.height * 4;
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingMemory;
+	createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::STAGING, stagingBuffer, stagingMemory);
+
+	// The upscale blit leaves the image in TRANSFER_SRC_OPTIMAL.
+	VkCommandBuffer commandBuffer = beginOneShotCommands();
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, offscreenImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuffer, 1, &region);
+
+	endOneShotCommands(commandBuffer);
+
+	void* data;
+	vkMapMemory(device, stagingMemory, 0, size, 0, &data);
+	pixels.resize(static_cast<size_t>(size));
+	memcpy(pixels.data(), data, pixels.size());
+	vkUnmapMemory(device, stagingMemory);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	freeMemory(stagingMemory);
+}
+
 void VkApplication::mainLoop()
 {
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
+		drawFrame();
 	}
+
+	vkDeviceWaitIdle(device);
 }
 
 void VkApplication::cleanup()
 {
 	destructed = true;
 
-	for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-		vkDestroyImageView(device, swapChainImageViews[i], nullptr);
+	if (device != VK_NULL_HANDLE) {
+		vkDeviceWaitIdle(device);
+
+		capture.destroy();
+
+		if (timestampPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, timestampPool, nullptr);
+		}
+
+		for (size_t i = 0; i < inFlightFences.size(); i++) {
+			vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
+			vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+			vkDestroyFence(device, inFlightFences[i], nullptr);
+		}
+
+		vkDestroyCommandPool(device, commandPool, nullptr);
+
+		for (size_t i = 0; i < framebuffers.size(); i++) {
+			vkDestroyFramebuffer(device, framebuffers[i], nullptr);
+		}
+
+		vkDestroyPipeline(device, graphicsPipeline, nullptr);
+		vkDestroyRenderPass(device, renderPass, nullptr);
+
+		bindlessTable.destroy();
+
+		for (size_t i = 0; i < swapChainImageViews.size(); i++) {
+			vkDestroyImageView(device, swapChainImageViews[i], nullptr);
+		}
+
+		vkDestroyImageView(device, renderTargetView, nullptr);
+		vkDestroyImage(device, renderTarget, nullptr);
+		freeMemory(renderTargetMemory);
+
+		if (offscreen) {
+			vkDestroyImage(device, offscreenImage, nullptr);
+			freeMemory(offscreenMemory);
+		}
+		else {
+			vkDestroySwapchainKHR(device, swapChain, nullptr);
+		}
+
+		memoryBudget.destroy();
+
+		vkDestroyDevice(device, nullptr);
 	}
 
-	vkDestroySwapchainKHR(device, swapChain, nullptr);
-	vkDestroySurfaceKHR(inst, surface, nullptr);
+	if (surface != VK_NULL_HANDLE) {
+		vkDestroySurfaceKHR(inst, surface, nullptr);
+	}
 
+	if (inst != VK_NULL_HANDLE) {
 #ifdef USE_VALIDATION
-	DestroyDebugReportCallbackEXT(inst, callback, nullptr);
+		DestroyDebugReportCallbackEXT(inst, callback, nullptr);
 #endif
 
-	vkDestroyDevice(device, nullptr);
-	vkDestroyInstance(inst, nullptr);
+		vkDestroyInstance(inst, nullptr);
+	}
 
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	if (!offscreen) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 }
 
 #ifdef USE_VALIDATION
@@ -5,6 +5,10 @@
 
 #include "libs.h"
 #include "TVkR.h"
+#include "BindlessTable.h"
+#include "FrameCapture.h"
+#include "ResolutionController.h"
+#include "MemoryBudget.h"
 
 #include <vector>
 
@@ -12,14 +16,57 @@
 #define USE_VALIDATION
 #endif
 
+const int MAX_FRAMES_IN_FLIGHT = 2;
+
+// What gets drawn each frame. Every draw is the built-in triangle, so these
+// only change how much CPU submission and GPU fill work a frame costs.
+struct SceneParams
+{
+	uint32_t drawCount = 1;
+	uint32_t instanceCount = 1;
+};
+
 class VkApplication
 {
 public:
-	VkApplication(int width, int height, std::string app_name, Version version);
+	// An offscreen application has no window, surface or swap chain, and
+	// renders into a single image that can be read back with readbackFrame().
+	VkApplication(int width, int height, std::string app_name, Version version, bool offscreen = false);
 	~VkApplication();
 
 	void run();
 
+	void init();
+	void drawFrame();
+	void waitIdle();
+
+	void setScene(const SceneParams& params) { scene = params; }
+	// Only has an effect before init().
+	void setPreferredDeviceType(VkPhysicalDeviceType type) { preferredDeviceType = type; }
+
+	// Tightly packed RGBA8 pixels of the last rendered frame. Offscreen only,
+	// and only once a frame has been drawn.
+	void readbackFrame(std::vector<uint8_t>& pixels);
+
+	// Streams every presented frame to `sink` until stopCapture(). May be
+	// called before init(). The sink isn't owned and has to stay alive until
+	// stopCapture() or cleanup, which deliver the frames still in flight.
+	// run() and stopCapture() rethrow sink errors; cleanup drops them.
+	void startCapture(FrameSink* sink);
+	void stopCapture();
+	uint64_t getCapturedFrameCount() { return capture.getCapturedCount(); }
+	uint64_t getDroppedFrameCount() { return capture.getDroppedCount(); }
+
+	// The scene is rendered at `scale` (per axis) of the output resolution
+	// and scaled up when it's copied to the output. Turns off dynamic
+	// resolution. Swap chains that can't be blitted to are always rendered
+	// at full resolution.
+	void setRenderScale(float scale);
+	// Lets the controller pick the scale each frame from the GPU timestamps.
+	// Without timestamp support the scale just stays where it is.
+	void enableDynamicResolution(const ResolutionController::Settings& settings);
+	void disableDynamicResolution() { dynamicResolution = false; }
+
 public:
 #ifdef USE_VALIDATION
 	static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
@@ -32,36 +79,107 @@ public:
 		const char* msg,
 		void* userData);
 #endif
-	
+
+	VkInstance getInstance() { return inst; }
 	VkSurfaceKHR getSurface() { return surface; }
+	bool hasPhysicalDeviceProperties2() { return hasProperties2; }
+	bool isOffscreen() { return offscreen; }
 
 	int getWidth() { return width; }
 	int getHeight() { return height; }
 
+	std::string getDeviceName() { return physicalDeviceProperties.deviceName; }
+	// GPU time of the most recently completed frame in milliseconds, or a
+	// negative value when the queue has no timestamp support.
+	double getLastGPUTime() { return lastGPUTime; }
+	uint32_t getDeviceAllocationCount() { return memoryBudget.getAllocationCount(); }
+	MemoryBudget& getMemoryBudget() { return memoryBudget; }
+
+	float getRenderScale() { return directOutput ? 1.0f : renderScale; }
+	VkExtent2D getRenderExtent();
+
 private:
 
 	int width;
 	int height;
 	std::string app_name;
 	Version version;
+	bool offscreen;
+	VkPhysicalDeviceType preferredDeviceType = VK_PHYSICAL_DEVICE_TYPE_MAX_ENUM;
 
-	GLFWwindow* window;
-	VkInstance inst;
-	VkSurfaceKHR surface;
+	GLFWwindow* window = nullptr;
+	VkInstance inst = VK_NULL_HANDLE;
+	bool hasProperties2 = false;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
 
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-	VkDevice device;
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	DescriptorIndexingSupport descriptorIndexing;
+	MemoryBudgetSupport memoryBudgetSupport;
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryBudget memoryBudget;
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
 
-	VkSwapchainKHR swapChain;
+	// The output images. In offscreen mode these hold the one offscreen
+	// image.
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> swapChainImages;
-	std::vector<VkImageView> swapChainImageViews;
 	VkFormat imageFormat;
 	VkExtent2D swapChainExtent;
+	// Whether the images can be copied from, which capture needs.
+	bool swapChainTransferSrc = false;
+	// Set when the images can't be blitted to. The scene is then rendered
+	// straight into them at full resolution, through these views.
+	bool directOutput = false;
+	std::vector<VkImageView> swapChainImageViews;
+
+	VkImage offscreenImage = VK_NULL_HANDLE;
+	VkDeviceMemory offscreenMemory = VK_NULL_HANDLE;
+
+	// What the scene is rendered into. It's allocated once at the output
+	// size and frames only use its top left getRenderExtent() pixels, so a
+	// new render scale never means new memory, images or framebuffers.
+	VkImage renderTarget = VK_NULL_HANDLE;
+	VkDeviceMemory renderTargetMemory = VK_NULL_HANDLE;
+	VkImageView renderTargetView = VK_NULL_HANDLE;
+	VkFilter upscaleFilter = VK_FILTER_LINEAR;
+
+	float renderScale = 1.0f;
+	bool dynamicResolution = false;
+	ResolutionController resolutionController;
+
+	BindlessTable bindlessTable;
+
+	FrameCapture capture;
+	FrameSink* captureSink = nullptr;
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+	// One per swap chain image with directOutput, otherwise renderTarget's.
+	std::vector<VkFramebuffer> framebuffers;
+
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> commandBuffers;
+
+	std::vector<VkSemaphore> imageAvailableSemaphores;
+	std::vector<VkSemaphore> renderFinishedSemaphores;
+	std::vector<VkFence> inFlightFences;
+	size_t currentFrame = 0;
+	// Counts every frame, unlike currentFrame.
+	uint64_t frameNumber = 0;
+
+	// Two timestamps per frame in flight, bracketing its commands.
+	VkQueryPool timestampPool = VK_NULL_HANDLE;
+	uint32_t timestampValidBits = 0;
+	std::vector<bool> timestampsWritten;
+	double lastGPUTime = -1.0;
+
+	SceneParams scene;
 
 #ifdef USE_VALIDATION
-	VkDebugReportCallbackEXT callback;
+	VkDebugReportCallbackEXT callback = VK_NULL_HANDLE;
 #endif
 
 	void initWindow();
@@ -71,9 +189,26 @@ private:
 	void createSurface();
 	void pickDevice();
 	void createSwapChain();
+	void createOffscreenTarget();
+	void createRenderTarget();
 	void createImageViews();
 	void createLogicalDevice();
+	void createRenderPass();
 	void createGFXPipleine();
+	void createFramebuffers();
+	void createCommandBuffers();
+	void createSyncObjects();
+	void createTimestampQueries();
+
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	bool collectTimestamps(size_t frame);
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	VkDeviceMemory allocateMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryCategory category);
+	void freeMemory(VkDeviceMemory memory);
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category, VkBuffer& buffer, VkDeviceMemory& memory);
+	VkCommandBuffer beginOneShotCommands();
+	void endOneShotCommands(VkCommandBuffer commandBuffer);
 
 	void mainLoop();
 	void cleanup();
@@ -81,4 +216,3 @@ private:
 	bool destructed;
 
 };
-
@@ -16,4 +16,18 @@ void DestroyDebugReportCallbackEXT(VkInstance instance, VkDebugReportCallbackEXT
 	if (func != nullptr) {
 		func(instance, callback, pAllocator);
 	}
+}
+
+void GetPhysicalDeviceFeatures2KHR(VkInstance instance, VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2KHR* pFeatures) {
+	auto func = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+	if (func != nullptr) {
+		func(physicalDevice, pFeatures);
+	}
+}
+
+void GetPhysicalDeviceProperties2KHR(VkInstance instance, VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties2KHR* pProperties) {
+	auto func = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR");
+	if (func != nullptr) {
+		func(physicalDevice, pProperties);
+	}
 }
\ No newline at end of file
@@ -3,4 +3,9 @@
 #if defined(LOAD_DEBUG_REPORT) || defined(LOAD_ALL)
 VkResult CreateDebugReportCallbackEXT(VkInstance instance, const VkDebugReportCallbackCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugReportCallbackEXT* pCallback);
 void DestroyDebugReportCallbackEXT(VkInstance instance, VkDebugReportCallbackEXT callback, const VkAllocationCallbacks* pAllocator);
+#endif
+
+#if defined(LOAD_PHYSICAL_DEVICE_PROPERTIES2) || defined(LOAD_ALL)
+void GetPhysicalDeviceFeatures2KHR(VkInstance instance, VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2KHR* pFeatures);
+void GetPhysicalDeviceProperties2KHR(VkInstance instance, VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties2KHR* pProperties);
 #endif
\ No newline at end of file
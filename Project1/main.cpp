@@ -3,13 +3,32 @@
 #include "libs.h"
 #include "VkApplication.h"
 
-int main() {
+#include <memory>
+
+int main(int argc, char** argv) {
+	// Declared first so it outlives the capture writing to it, even when
+	// run() throws and app cleans up in its destructor.
+	std::unique_ptr<FrameSink> sink;
+
 	VkApplication app(1280, 720, ENGINE_FULL_NAME_STR + " Test", Version(1,0,0));
 
 	int exit = EXIT_SUCCESS;
 
 	try {
+		// --capture <file.y4m> records everything shown in the window.
+		if (argc > 2 && std::string(argv[1]) == "--capture") {
+			sink.reset(new Y4MSink(argv[2]));
+			app.startCapture(sink.get());
+		}
+
+		// Trade resolution for a steady 60 fps when the GPU can't keep up.
+		app.enableDynamicResolution(ResolutionController::Settings());
+
 		app.run();
+
+		if (sink) {
+			std::cout << "Captured " << app.getCapturedFrameCount() << " frames, dropped " << app.getDroppedFrameCount() << std::endl;
+		}
 	}
 	catch (const ERROR_TYPE& e) {
 		std::cerr << e.what() << std::endl;
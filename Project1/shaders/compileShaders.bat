@@ -3,4 +3,5 @@
 set CALL="%VULKAN_SDK%\Bin\glslangValidator.exe"
 
 %CALL% -V shader.frag
-%CALL% -V shader.vert
\ No newline at end of file
+%CALL% -V shader.vert
+%CALL% -V mesh.vert -o meshvert.spv
\ No newline at end of file
@@ -0,0 +1,36 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Decodes mesh::PackedVertex. The mesh's positionOffset is expected to be
+// folded into the transform, and uvOffsetScale holds the file's uvOffset
+// and uvScale.
+
+layout(push_constant) uniform PushConstants {
+    mat4 transform;
+    vec4 uvOffsetScale;
+} push;
+
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+layout(location = 2) in vec2 inUV;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragUV;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main() {
+    gl_Position = push.transform * vec4(inPosition.xyz, 1.0);
+    fragColor = decodeOctahedral(inNormal) * 0.5 + 0.5;
+    fragUV = push.uvOffsetScale.xy + inUV * push.uvOffsetScale.zw;
+}
\ No newline at end of file